@@ -0,0 +1,186 @@
+/*          Serial Programmer for AVR 4313 version
+      Ken Sarkies ksarkies@internode.on.net
+            (www.jiggerjuice.net)
+
+File              : hal.h
+Compiler          : AVR-GCC/avr-libc(>= 1.2.5), or gcc for the emulator
+Revision          : $Revision: 0.1 $
+
+Target platform   : ATTiny2313 or ATTiny4313, or Linux with EMULATOR defined
+
+Hardware access used by the firmware: the UART, the programming lines on PORTB
+and the delays. On the AVR these are the registers themselves. When EMULATOR is
+defined, the firmware is built as a Linux program and these are provided by the
+emulator, which connects the UART to a pty and the programming lines to a
+simulated target.
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <inttypes.h>
+
+#ifdef EMULATOR
+/*****************************************************************************/
+/* Linux build. The emulator provides all of these. */
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define _BV(bit) (1 << (bit))
+
+#define PB0 0
+#define PB1 1
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+/* The emulator has its own main, and runs the firmware's */
+#define main firmware
+int firmware(void);
+
+void initHardware(void);
+void sendchar(unsigned char c);
+unsigned char recchar(void);
+uint8_t charReady(void);
+uint8_t recbreak(uint8_t *datum);
+void pinsOutput(const uint8_t mask);
+void pinsInput(const uint8_t mask);
+void pinsHigh(const uint8_t mask);
+void pinHigh(const uint8_t pin);
+void pinLow(const uint8_t pin);
+uint8_t pinRead(const uint8_t pin);
+void traceCommand(const uint8_t command);
+void _delay_us(const double us);
+uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data);
+
+#else
+/*****************************************************************************/
+/* AVR build */
+
+#include <avr/eeprom.h>
+#include <avr/sfr_defs.h>
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <avr/pgmspace.h>
+
+// Definitions of microcontroller registers and other characteristics
+#define	_ATtiny2313
+//#define	_AT90S2313
+#ifdef	__ICCAVR__
+#include "iotn2313.h"
+#elif	__GNUC__
+#include <avr/io.h>
+#endif
+
+/* Convenience macros (we don't use them all) */
+#define  _BV(bit) (1 << (bit))
+#define  inb(sfr) _SFR_BYTE(sfr)
+#define  inw(sfr) _SFR_WORD(sfr)
+#define  outb(sfr, val) (_SFR_BYTE(sfr) = (val))
+#define  outw(sfr, val) (_SFR_WORD(sfr) = (val))
+#define  cbi(sfr, bit) (_SFR_BYTE(sfr) &= ~_BV(bit))
+#define  sbi(sfr, bit) (_SFR_BYTE(sfr) |= _BV(bit))
+
+#include <util/delay.h>
+#include <util/crc16.h>
+
+/* This defines our baudrate 25=19200, 12=38400, 8=57600 */
+#define BRREG_VALUE             12
+
+/* definitions for UART control */
+#ifdef _ATtiny2313
+#define	UART_STATUS UCSRA
+#endif
+#ifdef _AT90S2313
+#define	UART_STATUS USR
+#endif
+
+/* Programming lines, all on PORTB */
+#define pinsOutput(mask) outb(DDRB,(inb(DDRB) | (mask)))
+#define pinsInput(mask)  outb(DDRB,(inb(DDRB) & ~(mask)))
+#define pinsHigh(mask)   outb(PORTB,(inb(PORTB) | (mask)))
+#define pinHigh(pin)     sbi(PORTB,pin)
+#define pinLow(pin)      cbi(PORTB,pin)
+#define pinRead(pin)     ((inb(PINB) & _BV(pin))>>pin)
+
+/* Commands are only counted by the emulator */
+#define traceCommand(command)
+
+/*****************************************************************************/
+static void initbootuart(void)
+{
+#ifdef _ATtiny2313
+    UBRRL = BRREG_VALUE;
+    UBRRH = 0;
+    UCSRA = 0;
+    UCSRB = (1 << RXEN) | (1 << TXEN);  // enable receive and transmit
+    UCSRC = 6;                          // Set to 8-bit mode
+#endif
+#ifdef _AT90S2313
+    UBRR = BRREG_VALUE;
+    USR = (1 << RXEN) | (1 << TXEN);  // enable receive and transmit
+#endif
+}
+
+/*****************************************************************************/
+static void initHardware(void)
+{
+    sbi(ACSR,7);                        // Turn off Analogue Comparator
+    initbootuart();           	        // Initialize UART.
+}
+
+/*****************************************************************************/
+static void sendchar(unsigned char c)
+{
+    UDR = c;                                // Load data to Tx buffer
+    while (!(UART_STATUS & (1 << TXC)));    // wait until sent
+    UART_STATUS |= (1 << TXC);              // clear TXCflag
+}
+
+/*****************************************************************************/
+static unsigned char recchar(void)
+{
+  while(!(UART_STATUS & (1 << RXC)));       // wait for data
+  return UDR;
+}
+
+/*****************************************************************************/
+/* A character is waiting to be read */
+#define charReady() (UART_STATUS & (1 << RXC))
+
+/*****************************************************************************/
+/* Receive a character, and tell if it was a BREAK (a null with a framing
+error). The error flags must be read before the data. */
+static uint8_t recbreak(uint8_t *datum)
+{
+    while(!(UART_STATUS & (1 << RXC)));     // wait for data
+    uint8_t status = UART_STATUS;
+    *datum = UDR;
+    return ((status & (1 << FE)) && (*datum == 0));
+}
+
+#endif
+#endif
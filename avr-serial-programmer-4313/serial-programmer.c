@@ -20,13 +20,19 @@ The SPI port is used along with an additional output pin used to hold the target
 in a reset state. When programming has been completed, the board switches the
 serial communications to pass through to the target. This switches the incoming
 serial communications from the target through to the PC. The outgoing
-communications from the PC are simply copied to the target.
+communications from the PC are simply copied to the target. The programmer
+keeps listening to the PC while in passthrough, and a serial BREAK or a string
+of ESC characters returns it to the command interpreter.
+
+The UART, the programming lines and the delays are reached through hal.h, so
+that the same source can be built into the Linux emulator of the programmer.
 
 Refer to the Project documents for more details.
 
 The main differences between targets are:
-1. The availability of a busy status. If not available, fixed delays need to be
-   added where memory accesses are made, or rereading of the memory location.
+1. The availability of a busy status. If not available, the memory location last
+   written is reread until it returns the written value (data polling). Fixed
+   delays are only needed where the value written was 0xFF.
 2. The use of paged or individual FLASH memory programming. EEPROM can always be
    accessed individually, but some devices allow paged writes.
 3. The size of the memory pages. The AT90S2313 and ATTiny2313 are limited to 32
@@ -70,80 +76,14 @@ protocol to complete correctly even if the capability is not supported.
  ***************************************************************************/
 
 #include <inttypes.h>
-#include <avr/eeprom.h>
-#include <avr/sfr_defs.h>
-#include <avr/io.h>
-#include <avr/wdt.h>
-
-// Definitions of microcontroller registers and other characteristics
-#define	_ATtiny2313
-//#define	_AT90S2313
-#ifdef	__ICCAVR__
-#include "iotn2313.h"
-#elif	__GNUC__
-#include <avr/io.h>
-#endif
+#include "hal.h"
 
 #define TRUE 1
 #define FALSE 0
-/* Convenience macros (we don't use them all) */
-#define  _BV(bit) (1 << (bit))
-#define  inb(sfr) _SFR_BYTE(sfr)
-#define  inw(sfr) _SFR_WORD(sfr)
-#define  outb(sfr, val) (_SFR_BYTE(sfr) = (val))
-#define  outw(sfr, val) (_SFR_WORD(sfr) = (val))
-#define  cbi(sfr, bit) (_SFR_BYTE(sfr) &= ~_BV(bit))
-#define  sbi(sfr, bit) (_SFR_BYTE(sfr) |= _BV(bit))
 #define  high(x) ((uint8_t) (x >> 8) & 0xFF)
 #define  low(x) ((uint8_t) (x & 0xFF))
 
 #include "serial-programmer.h"
-#include <util/delay.h>
-
-/*****************************************************************************/
-/* Functions to send/receive */
-
-/* This defines our baudrate 25=19200, 12=38400, 8=57600 */
-#define BRREG_VALUE             12
-
-/* definitions for UART control */
-#ifdef _ATtiny2313
-#define	UART_STATUS UCSRA
-#endif
-#ifdef _AT90S2313
-#define	UART_STATUS USR
-#endif
-
-/*****************************************************************************/
-void initbootuart(void)
-{
-#ifdef _ATtiny2313
-    UBRRL = BRREG_VALUE;
-    UBRRH = 0;
-    UCSRA = 0;
-    UCSRB = (1 << RXEN) | (1 << TXEN);  // enable receive and transmit 
-    UCSRC = 6;                          // Set to 8-bit mode
-#endif
-#ifdef _AT90S2313
-    UBRR = BRREG_VALUE;
-    USR = (1 << RXEN) | (1 << TXEN);  // enable receive and transmit 
-#endif
-}
-
-/*****************************************************************************/
-void sendchar(unsigned char c)
-{
-    UDR = c;                                // Load data to Tx buffer
-    while (!(UART_STATUS & (1 << TXC)));    // wait until sent
-    UART_STATUS |= (1 << TXC);              // clear TXCflag
-}
-
-/*****************************************************************************/
-unsigned char recchar(void)
-{
-  while(!(UART_STATUS & (1 << RXC)));       // wait for data
-  return UDR;
-}
 
 /*****************************************************************************/
 /** @brief Array of parts and properties
@@ -169,9 +109,10 @@ We don't do the AT90S2313 yet as it requires special code development
 FPage is the FLASH  pagesize in words
 EPage is the EEPROM pagesize in bytes
 Busy indicates if the programming hardware provides a busy flag
+The table is kept in FLASH to leave RAM free for the block buffer.
 */
 #define NUMPARTS 18
-uint8_t part[NUMPARTS][6] = {
+const uint8_t part[NUMPARTS][6] PROGMEM = {
 /* Sig 2, Sig 3, FPage, EPage, Busy, Lock/Fuse */
 //{   0x91,  0x01,    0,    0,   FALSE,  0x10     },  // AT90S2313
 {   0x91,  0x0B,   16,    4,   TRUE,   0xFF     },  // ATTiny24
@@ -206,6 +147,16 @@ uint8_t ePageSize;
 uint8_t canCheckBusy;
 uint8_t lfCapability;
 uint8_t received;
+uint8_t pollCommand;                // SPI read command for data polling
+uint16_t pollAddress;               // Location to be polled
+uint8_t pollValue = 0xFF;           // Value expected at the polled location
+uint8_t pageBuffer[MAXBLOCK];       // Block held in RAM for verified loads
+uint8_t *bufferPointer;             // Next block byte in RAM, or 0 if from serial
+uint8_t programming = FALSE;        // Target is held in programming mode
+uint16_t frameCrc;                  // CRC of a framed block or of a block read
+uint8_t readMode = READ_SEND;       // What is done with bytes of a block read
+uint8_t runValue;                   // Byte repeated in the current run
+uint8_t runLength;                  // Number of bytes in the current run
 
 int main(void)
 {
@@ -223,8 +174,7 @@ int main(void)
     PB6 = MISO
     PB7 = SCK */
 
-    sbi(ACSR,7);                        // Turn off Analogue Comparator
-    initbootuart();           	        // Initialize UART.
+    initHardware();                     // Comparator off and UART on.
     uint8_t sigByte1=0;                 // Target Definition defaults
     uint8_t sigByte2=0;
     uint8_t sigByte3=0;
@@ -239,6 +189,7 @@ int main(void)
         for(;;)
         {
             command=recchar();          // Loop and wait for command character.
+            traceCommand(command);
 
 /** 'a' Check autoincrement status.
 This allows a block of data to be uploaded to consecutive addresses without
@@ -299,6 +250,16 @@ non zero.*/
                 sendchar('0');
             }
 
+/** 'O' Return programmer options. This returns 'Y' followed by a bitmap of the
+capabilities beyond AVR109, MSB first (see CAP_ in the header). Programmers
+that don't know this command answer '?', which says no extras are present. */
+            else if (command=='O')
+            {
+                sendchar('Y');
+                sendchar(high(CAPABILITIES));
+                sendchar(low(CAPABILITIES));
+            }
+
 /** 't' Return supported device codes. This returns a list of devices that can
 be programmed. This is only used by AVRPROG so we will not use it - we work with
 signature bytes instead. */
@@ -322,20 +283,35 @@ is low. Send the command and ensure that the echoed second byte is correct,
 otherwise redo. With this we get the device signature and search the table for
 its characteristics. A timeout is provided in case the device doesn't respond.
 This will allow fall through to an ultimate error response.
-The reset line is held low until programming mode is exited. */
-            else if (command=='P')
+The reset line is held low until programming mode is exited.
+If the target is still in programming mode from an earlier 'P' and its
+signature still reads back, the cached signature and fuse data are reused
+without going through the reset and synchronization again. */
+            else if ((command=='P') && programming &&
+                     (readSignature(0) == sigByte1) &&
+                     (readSignature(1) == sigByte2) &&
+                     (readSignature(2) == sigByte3))
             {
-                outb(DDRB,(inb(DDRB) | 0xB9));      // Setup SPI output ports
-                outb(PORTB,(inb(PORTB) | 0xB9));    // SCK and MOSI high, and LEDs off
+                sendchar('\r');
+            }
+
+/** 'U' Refresh programming mode.
+As for 'P' but the reset and synchronization are always done and the cached
+signature and fuse data are read again, for example after a fuse write. */
+            else if ((command=='P') || (command=='U'))
+            {
+                programming = FALSE;
+                pinsOutput(0xB9);                   // Setup SPI output ports
+                pinsHigh(0xB9);                     // SCK and MOSI high, and LEDs off
                 uint8_t retry = 10;
                 uint8_t result = 0;
                 while ((result != 0x53) && (retry-- > 0))
                 {
-                    cbi(PORTB,SCK);                 // Set serial clock low
-                    sbi(PORTB,RESET);               // Pulse reset line off
+                    pinLow(SCK);                    // Set serial clock low
+                    pinHigh(RESET);                 // Pulse reset line off
 // Delay to let CPU know that programming will occur
                     _delay_us(100);
-                    cbi(PORTB,RESET);               // Pulse reset line on
+                    pinLow(RESET);                  // Pulse reset line on
                     _delay_us(25000);               // 25ms delay
                     writeCommand(0xAC,0x53,0x00,0x00);  // "Start programming" command
                     result=buffer[2];
@@ -357,19 +333,20 @@ either not an Atmel device, is locked, or is not responding.*/
                 {
                     while ((partNo < NUMPARTS) && (! found))
                     {
-                        found = ((part[partNo][0] == sigByte2) &&
-                                (part[partNo][1] == sigByte3));
+                        found = ((pgm_read_byte(&part[partNo][0]) == sigByte2) &&
+                                (pgm_read_byte(&part[partNo][1]) == sigByte3));
                         partNo++;
                     }
                 }
                 if (found)
                 {
                     partNo--;
+                    programming = TRUE;
                     sendchar('\r');
-                    fPageSize = part[partNo][2];
-                    ePageSize = part[partNo][3];
-                    canCheckBusy = part[partNo][4];
-                    lfCapability = part[partNo][5];
+                    fPageSize = pgm_read_byte(&part[partNo][2]);
+                    ePageSize = pgm_read_byte(&part[partNo][3]);
+                    canCheckBusy = pgm_read_byte(&part[partNo][4]);
+                    lfCapability = pgm_read_byte(&part[partNo][5]);
                     buffer[3] = 0;                      // In case we cannot read these
                     if (lfCapability & 0x08)
                         writeCommand(0x50,0x08,0x00,0x00);  // Read Extended Fuse Bits
@@ -386,18 +363,19 @@ either not an Atmel device, is locked, or is not responding.*/
                 }
                 else                                    // Not found?
                 {
-                    sbi(PORTB,RESET);                   // Lift reset line
+                    pinHigh(RESET);                     // Lift reset line
                     sendchar('?');                      // Device cannot be programmed
-                    outb(DDRB,(inb(DDRB) & ~0xA0));     // Set SPI ports to inputs
+                    pinsInput(0xA0);                    // Set SPI ports to inputs
                 }
             }
 
 /** 'L' Leave programming mode. */
             else if(command=='L')
             {
-                sbi(PORTB,RESET);                       // Turn reset line off
+                programming = FALSE;
+                pinHigh(RESET);                         // Turn reset line off
                 sendchar('\r');                         // Answer OK.
-                outb(DDRB,(inb(DDRB) & ~0xA0));         // Set SPI ports to inputs
+                pinsInput(0xA0);                        // Set SPI ports to inputs
             }
 
 /** 'e' Chip erase.
@@ -430,6 +408,7 @@ page but the address is not incremented.*/
             {
                 received = recchar();
                 writeCommand(0x40,0x00,address & 0x7F,received);    // Low byte
+                setPoll(0x20,address,received);
                 sendchar('\r');                         // Send OK back.
             }
 
@@ -440,6 +419,7 @@ the responsibility of the user to issue a page write command.*/
             {
                 received = recchar();
                 writeCommand(0x48,0x00,address & 0x7F,received);    // High Byte
+                setPoll(0x28,address,received);
                 address++;                              // Auto-advance to next Flash word.
                 sendchar('\r');                         // Send OK back.
             }
@@ -465,7 +445,9 @@ This requires several ms. Ensure that the command has finished before acknowledg
                 lsbAddress = low(address);
                 msbAddress = high(address);
 // EEPROM byte
-                writeCommand(0xC0,msbAddress,lsbAddress,recchar());
+                received = recchar();
+                writeCommand(0xC0,msbAddress,lsbAddress,received);
+                setPoll(0xA0,address,received);
                 address++;                              // Auto-advance to next EEPROM byte.
                 pollDelay(FALSE);                       // Long delay
                 sendchar('\r');                         // Send OK back.
@@ -490,6 +472,92 @@ This requires several ms. Ensure that the command has finished before acknowledg
                 sendchar(BlockLoad(tempInt,recchar(),&address));  // Block load.
             }
 
+/** 'K' Start CRC framed block load.
+As for 'B', but the whole block is received into RAM before it is written, so
+it is limited to MAXBLOCK bytes. It is followed by a CRC16 (XMODEM, MSB
+first) taken over the size, memory type and data bytes. Nothing is written
+unless the CRC checks, so a frame damaged on the link is answered with NAK after
+the link has gone quiet, and can simply be sent again. Otherwise the response
+is that of the block load. The address is only advanced once the block is
+written.*/
+
+/** 'Z' Start compressed CRC framed block load.
+As for 'K', but the size and memory type are followed by the size of the sent
+data (MSB first), which is run length encoded. RLE_MARKER, count, value expands
+to count copies of value, and any other byte stands for itself. The block is
+decoded into RAM as it arrives, and the CRC covers the data as sent. A decoded
+block that doesn't come to the given size is answered with NAK, as is an empty
+block for any of these commands.*/
+
+/** 'W' Start CRC framed block load with verification.
+As for 'K', but once committed, the block is read back from the target and
+compared with the RAM copy. The CRC ensures that the RAM copy is what the PC
+sent. This returns '\r' if all is well, or '!' followed by the offset of the
+first mismatch in the block (MSB first).*/
+            else if ((command=='K') || (command=='Z') || (command=='W'))
+            {
+                uint8_t compressed = (command=='Z');
+                uint8_t verified = (command=='W');
+                frameCrc = 0;
+                tempInt = (recFramed()<<8);             // Get block size high byte first.
+                tempInt |= recFramed();                 // Low Byte.
+                command = recFramed();                  // Get memory type
+                uint16_t length = tempInt;
+                if (compressed)
+                {
+                    length = (recFramed()<<8);          // Size as sent
+                    length |= recFramed();
+                }
+                uint16_t n = 0;
+                if (length <= MAXBLOCK)
+                {
+                    while (length-- > 0)
+                    {
+                        received = recFramed();
+                        uint8_t run = 1;
+                        if (compressed && (received == RLE_MARKER) && (length >= 2))
+                        {
+                            run = recFramed();
+                            received = recFramed();
+                            length -= 2;
+                        }
+                        for (; run > 0; run--)
+                        {
+                            if (n < MAXBLOCK) pageBuffer[n] = received;
+                            n++;
+                        }
+                    }
+                    recFramed();                        // CRC
+                    recFramed();
+                }
+                else n = tempInt+1;                     // Too long to take
+                if ((n != tempInt) || (tempInt == 0) || (tempInt > MAXBLOCK) ||
+                    (frameCrc != 0))
+                {
+                    flushInput();
+                    sendchar(NAK);
+                }
+                else
+                {
+                    uint16_t blockAddress = address;
+                    bufferPointer = pageBuffer;
+                    received = BlockLoad(tempInt,command,&address);
+                    bufferPointer = 0;
+                    if ((received != '\r') || (! verified)) sendchar(received);
+                    else
+                    {
+                        uint16_t offset = BlockCompare(tempInt,command,blockAddress);
+                        if (offset >= tempInt) sendchar('\r');
+                        else
+                        {
+                            sendchar('!');
+                            sendchar(high(offset));     // MSB first.
+                            sendchar(low(offset));
+                        }
+                    }
+                }
+            }
+
 /** 'g' Start block read.
  The address must have already been set otherwise it will be undefined.*/
             else if (command=='g')
@@ -499,6 +567,37 @@ This requires several ms. Ensure that the command has finished before acknowledg
                 command = recchar();                    // Get memory type
                 BlockRead(tempInt,command,&address);    // Block read
             }
+
+/** 'G' Start run length encoded block read.
+As for 'g', but runs of identical bytes are sent as RLE_MARKER, count, value in
+the same way as for 'Z'. The caller knows the size it asked for, so it reads
+until that many bytes have been decoded.*/
+            else if (command=='G')
+            {
+                tempInt = (recchar()<<8);               // Get block size high byte first.
+                tempInt |= recchar();                   // Low Byte.
+                command = recchar();                    // Get memory type
+                readMode = READ_ENCODE;
+                BlockRead(tempInt,command,&address);    // Block read
+                readMode = READ_SEND;
+            }
+
+/** 'H' Checksum a block.
+As for 'g', but instead of the block, only a CRC16 (XMODEM) over it is returned,
+MSB first. This allows the PC to check whether the target already holds an
+image without reading it all back.*/
+            else if (command=='H')
+            {
+                tempInt = (recchar()<<8);               // Get block size high byte first.
+                tempInt |= recchar();                   // Low Byte.
+                command = recchar();                    // Get memory type
+                readMode = READ_CRC;
+                frameCrc = 0;
+                BlockRead(tempInt,command,&address);    // Block read
+                readMode = READ_SEND;
+                sendchar(high(frameCrc));
+                sendchar(low(frameCrc));
+            }
 /** 'r' Read lock bits. */
             else if (command=='r')
             {
@@ -562,18 +661,34 @@ This requires several ms. Ensure that the command has finished before acknowledg
                 sendchar(sigByte1);
             }
 
+/** 'X' Reset and run the target.
+Pulse the target reset line and then release it so that the application starts.
+The programmer stays in command mode, so that a further 'P' can be issued
+without a hardware reset of the programmer.*/
+            else if (command=='X')
+            {
+                programming = FALSE;
+                pinsInput(0xA0);                // Set SPI ports to inputs
+                pinsOutput(_BV(RESET));
+                pinLow(RESET);                  // Pulse reset line on
+                _delay_us(100);
+                pinHigh(RESET);                 // Lift reset line
+                sendchar('\r');
+            }
+
 /** 'E' Exit bootloader.
-At this command we enter serial passthrough and don't return from it until a
-hardware reset occurs.
-At the same time we should lift the reset from the target. Spin endlessly so we
-don't interpret serial data, and wait for our own hard reset.*/
+At this command we enter serial passthrough and lift the reset from the target.
+We don't interpret serial data while the target has the link, but watch for
+a BREAK or escape sequence from the PC to return to the command interpreter.*/
             else if (command=='E')
             {
+                programming = FALSE;
                 sendchar('\r');
-                sbi(PORTB,RESET);               // Pulse reset line off
-                cbi(PORTB,PASSTHROUGH);         // Change to serial passthrough
-                outb(DDRB,(inb(DDRB) & ~0xA0)); // Set SPI ports to inputs
-                for (;;);                    // Spin endlessly
+                pinHigh(RESET);                 // Pulse reset line off
+                pinLow(PASSTHROUGH);            // Change to serial passthrough
+                pinsInput(0xA0);                // Set SPI ports to inputs
+                passThrough();                  // Wait for the PC to call us back
+                pinHigh(PASSTHROUGH);           // Take back the serial link
             }
 
 /** The last command to accept is ESC (synchronization).
@@ -585,6 +700,67 @@ Otherwise, the command is not recognized and a "?" is returned.*/
     }
 }
 
+/********************************************************************************/
+/** @brief Serial passthrough to the target
+
+The target owns the serial link while we are here, but the data from the PC is
+still seen by our UART. A BREAK shows up as a null character with a framing
+error. Either that, or ESCAPE_COUNT consecutive ESC characters, ends the
+passthrough. Anything else is the target's business and is ignored.
+*/
+
+void passThrough(void)
+{
+    uint8_t escapes = 0;
+    for (;;)
+    {
+        uint8_t datum;
+        if (recbreak(&datum)) return;           // BREAK
+        if (datum == 0x1B)
+        {
+            if (++escapes >= ESCAPE_COUNT) return;
+        }
+        else escapes = 0;
+    }
+}
+
+/********************************************************************************/
+/** @brief Receive a byte of a CRC framed block
+
+@returns the byte, which is also added into the frame CRC
+*/
+uint8_t recFramed(void)
+{
+    uint8_t datum = recchar();
+    frameCrc = _crc_xmodem_update(frameCrc,datum);
+    return datum;
+}
+
+/********************************************************************************/
+/** @brief Discard serial data until the link goes quiet
+
+Used after a damaged frame, so that whatever remains of it is not taken as
+commands. The link is quiet once nothing has arrived for FLUSH_IDLE periods of
+10us.
+*/
+void flushInput(void)
+{
+    uint16_t idle = 0;
+    while (idle < FLUSH_IDLE)
+    {
+        if (charReady())
+        {
+            received = recchar();
+            idle = 0;
+        }
+        else
+        {
+            _delay_us(10);
+            idle++;
+        }
+    }
+}
+
 /********************************************************************************/
 /** @brief Write a block to application memory
 
@@ -598,6 +774,9 @@ bytes, while the FLASH buffer can be from 16 to 64 words.
 Take care that EEPROM addresses are given in bytes, while FLASH addresses are
 in words.
 
+The data comes from the serial link, or from the RAM block buffer when
+bufferPointer has been set.
+
 The code is a bit involved when dealing with non-paged support. We do not use
 pages at all so pageSize is irrelevant and ends up being -1, which in unsigned
 arithmetic should be all 1's. However it is used to set the addresses in both
@@ -627,21 +806,30 @@ unsigned char BlockLoad(uint16_t size, unsigned char mem, uint16_t *address)
         uint8_t lsbAddress = (*address) & pageMask;         // Address within page
         if (mem=='E')
         {
+            received = getDatum();
             if (ePageSize == 0)                             // Check Page Capability
             {
 // Get and write EEPROM byte direct
-                writeCommand(0xC0,0x00,lsbAddress,recchar());
+                writeCommand(0xC0,high(*address),low(*address),received);
+                setPoll(0xA0,*address,received);
                 pollDelay(FALSE);   // Long wait for completion of write command
             }
             else
+            {
 // Get and write EEPROM byte to its page
-                writeCommand(0xC1,0x00,lsbAddress,recchar());
+                writeCommand(0xC1,0x00,lsbAddress,received);
+                setPoll(0xA0,*address,received);
+            }
             blockCount+=1;
         }
         else
         {
-            writeCommand(0x40,0x00,lsbAddress,recchar());   // FLASH Low byte
-            writeCommand(0x48,0x00,lsbAddress,recchar());   // FLASH High Byte
+            received = getDatum();
+            writeCommand(0x40,0x00,lsbAddress,received);    // FLASH Low byte
+            setPoll(0x20,*address,received);
+            received = getDatum();
+            writeCommand(0x48,0x00,lsbAddress,received);    // FLASH High Byte
+            setPoll(0x28,*address,received);
 // Short wait for completion of write command
             if (fPageSize == 0) pollDelay(TRUE);
             blockCount+=2;
@@ -676,6 +864,49 @@ unsigned char BlockLoad(uint16_t size, unsigned char mem, uint16_t *address)
     return '\r';
 }
 
+/*****************************************************************************/
+/** @brief Get the next byte of a block being loaded
+
+@returns the byte, from the RAM block buffer if in use, otherwise the serial link
+*/
+
+uint8_t getDatum(void)
+{
+    if (bufferPointer == 0) return recchar();
+    return *bufferPointer++;
+}
+
+/*****************************************************************************/
+/** @brief Compare a block in application memory with the RAM block buffer
+
+The block is read back over the SPI interface, so nothing crosses the serial
+link. FLASH words are held in the buffer low byte first.
+
+@param[in] size: Size of the block in bytes
+@param[in] mem:  Memory type ('E' or 'F')
+@param[in] address: memory address in bytes (EEPROM) or words (FLASH)
+@returns offset of the first mismatch in the block, or size if all match
+*/
+
+uint16_t BlockCompare(const unsigned int size, const unsigned char mem,
+                      uint16_t address)
+{
+    for (uint16_t n=0; n < size; n++)
+    {
+        lsbAddress = low(address);
+        msbAddress = high(address);
+        if (mem=='E')
+            writeCommand(0xA0,msbAddress,lsbAddress,0x00);      // EEPROM Byte
+        else if (n & 0x01)
+            writeCommand(0x28,msbAddress,lsbAddress,0x00);      // FLASH High Byte
+        else
+            writeCommand(0x20,msbAddress,lsbAddress,0x00);      // FLASH Low Byte
+        if (buffer[3] != pageBuffer[n]) return n;
+        if ((mem=='E') || (n & 0x01)) address++;
+    }
+    return size;
+}
+
 /*****************************************************************************/
 /** @brief Read a block from application memory
 
@@ -689,6 +920,9 @@ in words.
 Note that the low byte is returned first, followed by the high byte. This
 differs from the 'R' command in which the high byte is returned first.
 
+The bytes go out through sendRead, so that they can be run length encoded or
+checksummed instead.
+
 @param[in] size: Size of the buffer in bytes
 @param[in] mem:  Memory type ('E' or 'F')
 @param[in] *address: pointer to memory address in bytes (EEPROM) or words (FLASH)
@@ -706,15 +940,59 @@ void BlockRead(unsigned int size, unsigned char mem, uint16_t *address)
             else
             {
                 writeCommand(0x20,msbAddress,lsbAddress,0x00);  // FLASH Low Byte
-                sendchar(buffer[3]);
+                sendRead(buffer[3]);
                 writeCommand(0x28,msbAddress,lsbAddress,0x00);  // FLASH High Byte
             }
-            sendchar(buffer[3]);
+            sendRead(buffer[3]);
             (*address)++;                                       // Select next FLASH word
         }
+        sendRun();
     }
 }
 
+/*****************************************************************************/
+/** @brief Send a byte read from application memory
+
+Normally this just sends the byte. For a checksum the byte is added into the
+CRC instead. For run length encoding the byte is added to the current run,
+which is sent when a different byte turns up or the run is as long as the
+count allows.
+
+@param[in] datum: the byte read
+*/
+
+void sendRead(const uint8_t datum)
+{
+    if (readMode == READ_SEND) sendchar(datum);
+    else if (readMode == READ_CRC) frameCrc = _crc_xmodem_update(frameCrc,datum);
+    else if ((runLength > 0) && (datum == runValue) && (runLength < 255)) runLength++;
+    else
+    {
+        sendRun();
+        runValue = datum;
+        runLength = 1;
+    }
+}
+
+/*****************************************************************************/
+/** @brief Send the current run of identical bytes
+
+A run of more than three, or of the marker itself, goes as RLE_MARKER, count,
+value. Otherwise the bytes are sent as they are.
+*/
+
+void sendRun(void)
+{
+    if ((runLength > 3) || ((runLength > 0) && (runValue == RLE_MARKER)))
+    {
+        sendchar(RLE_MARKER);
+        sendchar(runLength);
+        sendchar(runValue);
+    }
+    else for (; runLength > 0; runLength--) sendchar(runValue);
+    runLength = 0;
+}
+
 /*****************************************************************************/
 /** @brief Write a Byte to the SPI
 
@@ -733,13 +1011,14 @@ uint8_t writeByte(const uint8_t datum)
     uint8_t response = 0;
     for (uint8_t n=0; n < 8;  n++)
     {
-        outb(PORTB,(inb(PORTB) & ~_BV(MOSI))|((value & 0x80)>>(7-MOSI)));// Shift data MSB and put to MISO pin
+        if (value & 0x80) pinHigh(MOSI);    // Shift data MSB and put to MOSI pin
+        else pinLow(MOSI);
         _delay_us(SPI_DELAY);       // Give him some time to settle
-        sbi(PORTB,SCK);             // Raise SCK to latch output data
+        pinHigh(SCK);               // Raise SCK to latch output data
         _delay_us(SPI_DELAY);       // Give him some time to settle
         response <<= 1;             // Prepare response for next input bit
-        response |= (inb(PINB) & _BV(MISO))>>MISO;    // Add in next bit read
-        cbi(PORTB,SCK);             // Drop SCK ready for next time
+        response |= pinRead(MISO);  // Add in next bit read
+        pinLow(SCK);                // Drop SCK ready for next time
         _delay_us(SPI_DELAY);       // Give him some time to settle
         value <<= 1;                // Move to expose next bit
     }
@@ -769,12 +1048,50 @@ void writeCommand(const uint8_t cmd, const uint8_t parm1, const uint8_t parm2,
     buffer[2] = writeByte(parm2);
     buffer[3] = writeByte(parm3);
 }
+/*****************************************************************************/
+/** @brief Read a signature byte from the target
+
+@param[in] index  Signature byte number 0 to 2
+@returns The signature byte read back
+*/
+
+uint8_t readSignature(const uint8_t index)
+{
+    writeCommand(0x30,0x00,index,0x00);
+    return buffer[3];
+}
+
+/*****************************************************************************/
+/** @brief Note a location for data polling
+
+A write in progress reads back as 0xFF, so only a location loaded with some
+other value can be polled for completion. The last such location is kept for
+pollDelay.
+
+@param[in] readCommand  SPI command to read the location back
+@param[in] location     Address of the location (bytes for EEPROM, words for FLASH)
+@param[in] datum        Value written to the location
+*/
+
+void setPoll(const uint8_t readCommand, const uint16_t location,
+             const uint8_t datum)
+{
+    if (datum != 0xFF)
+    {
+        pollCommand = readCommand;
+        pollAddress = location;
+        pollValue = datum;
+    }
+}
+
 /*****************************************************************************/
 /** @brief Delay loop for writes.
 
 The target capability for polling the busy status is used to determine if this
-is to be used or if a fixed delay is needed. The delay is passed in the
-parameter.
+is to be used. If not, the location noted by setPoll is read back until it
+returns the written value, up to a limit of about the fixed delay in POLL_STEP
+intervals. Failing all that a fixed delay is needed. The delay is passed in the
+parameter. The polled location is used up by the call.
 
 The compiler has a problem with passing a parameter to _delay_ms, and memory
 usage bloats. So we need some fixed delays. Most likely _delay_us is too general
@@ -794,10 +1111,21 @@ void pollDelay(const uint8_t shortDelay)
         do writeCommand(0xF0,0x00,0x00,0x00);       // This needs several ms, so
         while (buffer[3] & 0x01);                   // Wait for busy flag to drop
     }
+    else if (pollValue != 0xFF)
+    {
+        uint8_t timeout = (shortDelay ? (4500/POLL_STEP) : (9000/POLL_STEP));
+        do
+        {
+            _delay_us(POLL_STEP);
+            writeCommand(pollCommand,high(pollAddress),low(pollAddress),0x00);
+        }
+        while ((buffer[3] != pollValue) && (--timeout > 0));
+    }
     else
     {
         if (shortDelay) _delay_us(4500);
         else _delay_us(9000);
     }
+    pollValue = 0xFF;
 }
 
@@ -45,6 +45,42 @@ Target platform   : AT90S2313 or ATTiny2313
 /* EEPROM Pagesize in words */
 #define EPAGESIZE   4
 
+/* Largest block in bytes that can be held in RAM for a verified load. This
+must cover the largest FLASH page (64 words). */
+#define MAXBLOCK    128
+
+/* Interval in microseconds between data polling reads for targets without a
+busy flag */
+#define POLL_STEP   100
+
+/* Number of consecutive ESC characters that end serial passthrough */
+#define ESCAPE_COUNT 16
+
+/* Response to a damaged CRC framed block, and the number of 10us periods
+without data that mark the end of its remains (about 8 characters at 38400) */
+#define NAK         0x15
+#define FLUSH_IDLE  200
+
+/* Introduces a run of identical bytes in run length encoded blocks */
+#define RLE_MARKER  0xA5
+
+/* What a block read does with the bytes it reads */
+#define READ_SEND   0
+#define READ_ENCODE 1
+#define READ_CRC    2
+
+/* Capability bits reported by the 'O' command */
+#define CAP_VERIFY      0x0001      // 'W' CRC framed block load verified by the programmer
+#define CAP_RUN         0x0002      // 'X' target run, passthrough can be left
+#define CAP_DATAPOLL    0x0004      // Data polling for targets without busy flag
+#define CAP_FASTENTRY   0x0008      // 'P' reuses programming mode, 'U' refreshes
+#define CAP_CRC         0x0010      // 'K' CRC framed block load
+#define CAP_RLELOAD     0x0020      // 'Z' run length encoded framed block load
+#define CAP_RLEREAD     0x0040      // 'G' run length encoded block read
+#define CAP_CHECKSUM    0x0080      // 'H' CRC of a block
+#define CAPABILITIES    (CAP_VERIFY | CAP_RUN | CAP_DATAPOLL | CAP_FASTENTRY | \
+                         CAP_CRC | CAP_RLELOAD | CAP_RLEREAD | CAP_CHECKSUM)
+
 /* define pin for entering self programming mode */
 #define SCK         PB7		// SCK   pin of the target (output)
 #define MISO        PB6		// MISO  pin of the target (input)
@@ -54,13 +90,25 @@ Target platform   : AT90S2313 or ATTiny2313
 #define LEDPROG     PB1		// dual color LED output, anode green  (output)
 #define LED         PB0		// LED output, active low, dual color LED cathode green (output)
 
-unsigned char BlockLoad(const unsigned int size,
+unsigned char BlockLoad(const uint16_t size,
                         const unsigned char mem,
                         uint16_t *address);
 void BlockRead(const unsigned int size,
                         const unsigned char mem,
                         uint16_t *address);
+uint16_t BlockCompare(const unsigned int size,
+                        const unsigned char mem,
+                        uint16_t address);
+uint8_t getDatum(void);
+void sendRead(const uint8_t datum);
+void sendRun(void);
 uint8_t writeByte(const uint8_t datum);
 void writeCommand(uint8_t, uint8_t, uint8_t, uint8_t);
+uint8_t readSignature(const uint8_t index);
 void pollDelay(const uint8_t shortDelay);
+void setPoll(const uint8_t readCommand, const uint16_t location,
+             const uint8_t datum);
+void passThrough(void);
+void flushInput(void);
+uint8_t recFramed(void);
 
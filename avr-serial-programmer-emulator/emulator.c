@@ -0,0 +1,476 @@
+/**
+@mainpage AVR Serial Programmer Emulator
+@version 0.1
+@author Ken Sarkies (www.jiggerjuice.net)
+
+@brief A software stand-in for the serial programmer board and its target.
+
+@details The emulator opens a pseudo-terminal and runs the 4313 serial
+programmer firmware on it, so the PC program can be run, timed and debugged
+without the hardware:
+
+    avr-serial-programmer-emulator -d ATMega328 &
+    avrserialprog -P /dev/pts/N
+
+The firmware is the real source, built for Linux with its hardware access
+(hal.h) provided by hal.c. The UART is the pty, and the programming lines drive
+a simulated target (target.c). Everything runs on a simulated clock, charged
+for each serial character at the baud rate, each firmware delay, and each
+write the target has to complete. The emulator then paces itself so that the
+PC sees the simulated timing in real time, or at a scaled rate. The UART only
+holds a couple of received characters, as on the AVR, so a PC that sends while
+the programmer is busy loses data in the same way as it would with the
+hardware.
+
+Options:
+- -d part     target part (-l lists them), default ATMega328
+- -b baud     serial rate used for character timing, default 38400
+- -s us       time of the bit bang loop per SPI byte, beyond its delays
+- -w us       FLASH page write time in microseconds
+- -e us       EEPROM write time in microseconds
+- -x us       chip erase time in microseconds
+- -r n        characters the UART holds before overrun
+- -t scale    real time per simulated time, 0 to run as fast as possible
+- -L path     also make a symbolic link to the pty at path
+- -f faults   inject faults on the serial link (see faults.c)
+- -z seed     seed of the fault generator, default 1
+- -S          report SPI cycles and time per command on exit
+- -v          log commands to stderr
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include "emulator.h"
+
+/* Received characters that can be waiting in the pty side buffer */
+#define RX_QUEUE    65536
+/* Simulated time the emulator may run ahead of real time before it sleeps */
+#define PACE_CHUNK  (1*NS_PER_MS)
+
+struct Timing timing = {
+    DEFAULT_BAUD,
+    DEFAULT_SPI_OVERHEAD*NS_PER_US,
+    DEFAULT_FLASH_WRITE*NS_PER_US,
+    DEFAULT_EEPROM_WRITE*NS_PER_US,
+    DEFAULT_ERASE*NS_PER_US,
+    DEFAULT_RX_DEPTH,
+    1.0
+};
+uint64_t simClock;                  // Simulated time (ns)
+uint64_t waitClock;                 // Simulated time spent waiting for the PC
+int verbose;
+
+static int master = -1;             // pty master, the programmer's side
+static uint8_t rxData[RX_QUEUE];    // Characters on their way to the UART
+static uint64_t rxArrival[RX_QUEUE];// Simulated time each one is complete
+static uint32_t rxHead;
+static uint32_t rxTail;
+static uint64_t lastArrival;
+static uint8_t txData[256];         // Characters waiting to go to the pty
+static uint32_t txCount;
+static uint64_t realStart;          // Real time at start (ns)
+static const char *linkPath;
+static uint32_t overruns;
+static int stats;                   // Report per command figures on exit
+static volatile sig_atomic_t stopping;
+
+static uint64_t realTime(void);
+static uint64_t characterTime(void);
+static void openPty(void);
+static void flushOutput(void);
+static void drainInput(const int timeout);
+static void pace(void);
+static void overrun(void);
+static void stop(int signal);
+static void finish(void);
+
+/*****************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    const struct Part *device = findPart("ATMega328");
+    const char *faultList = 0;
+    uint32_t seed = 1;
+    int c;
+    while ((c = getopt(argc,argv,"d:b:s:w:e:x:r:t:L:f:z:lSv")) != -1)
+    {
+        switch (c)
+        {
+            case 'd':
+                device = findPart(optarg);
+                if (device == 0)
+                {
+                    fprintf(stderr,"Unknown part %s, -l lists them\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'b': timing.baud = strtoul(optarg,0,0); break;
+            case 's': timing.spiOverhead = strtod(optarg,0)*NS_PER_US; break;
+            case 'w': timing.flashWrite = strtod(optarg,0)*NS_PER_US; break;
+            case 'e': timing.eepromWrite = strtod(optarg,0)*NS_PER_US; break;
+            case 'x': timing.erase = strtod(optarg,0)*NS_PER_US; break;
+            case 'r': timing.rxDepth = strtoul(optarg,0,0); break;
+            case 't': timing.scale = strtod(optarg,0); break;
+            case 'L': linkPath = optarg; break;
+            case 'f': faultList = optarg; break;
+            case 'z': seed = strtoul(optarg,0,0); break;
+            case 'l': listParts(); return 0;
+            case 'S': stats = TRUE; break;
+            case 'v': verbose = TRUE; break;
+            default:
+                fprintf(stderr,"Usage: %s [-d part] [-b baud] [-s us] [-w us] "
+                        "[-e us] [-x us] [-r depth] [-t scale] [-L link] "
+                        "[-f faults] [-z seed] [-l] [-S] [-v]\n",argv[0]);
+                return 1;
+        }
+    }
+    if ((timing.baud == 0) || (timing.rxDepth == 0))
+    {
+        fprintf(stderr,"Baud rate and UART depth must be nonzero\n");
+        return 1;
+    }
+    if ((faultList != 0) && ! setFaults(faultList,seed))
+    {
+        fprintf(stderr,"Cannot understand faults %s\n",faultList);
+        return 1;
+    }
+    targetInit(device);
+    openPty();
+    struct sigaction action;
+    memset(&action,0,sizeof(action));
+    action.sa_handler = stop;
+    sigaction(SIGINT,&action,0);
+    sigaction(SIGTERM,&action,0);
+    sigaction(SIGHUP,&action,0);
+    realStart = realTime();
+    firmware();
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Open the pseudo-terminal and announce it
+
+The slave side is held open as well, so that the PC program can open and close
+it as often as it likes without the master seeing a hangup. It is set raw so
+that nothing is translated before the PC program sets it up itself.
+*/
+
+static void openPty(void)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0))
+    {
+        perror("Cannot open a pty");
+        exit(1);
+    }
+    const char *name = ptsname(master);
+    int slave = open(name,O_RDWR | O_NOCTTY);
+    struct termios settings;
+    if ((slave < 0) || (tcgetattr(slave,&settings) < 0))
+    {
+        perror("Cannot open the pty slave");
+        exit(1);
+    }
+    cfmakeraw(&settings);
+    tcsetattr(slave,TCSANOW,&settings);
+    fcntl(master,F_SETFL,fcntl(master,F_GETFL) | O_NONBLOCK);
+    if (linkPath != 0)
+    {
+        unlink(linkPath);
+        if (symlink(name,linkPath) < 0) perror("Cannot link to the pty");
+    }
+    printf("%s\n",name);
+    fflush(stdout);
+}
+
+/*****************************************************************************/
+/** @brief Ask for the emulator to stop on a signal
+
+The firmware never returns, so the link code stops it at the next wait.
+*/
+
+static void stop(int signal)
+{
+    (void)signal;
+    stopping = TRUE;
+}
+
+/*****************************************************************************/
+/** @brief Report and tidy up */
+
+static void finish(void)
+{
+    flushOutput();
+    if (linkPath != 0) unlink(linkPath);
+    if (overruns > 0) fprintf(stderr,"%u characters lost to overrun\n",overruns);
+    printFaults();
+    if (stats) printStats();
+    exit(0);
+}
+
+/*****************************************************************************/
+/** @brief Advance the simulated clock
+
+@param[in] ns Simulated time spent
+*/
+
+void advance(const uint64_t ns)
+{
+    simClock += ns;
+}
+
+/*****************************************************************************/
+/** @brief Receive a character
+
+Waits for a character from the PC. If it is not yet complete at the simulated
+time, the clock is moved on to when it is, as for the firmware's polled wait.
+
+@returns the character
+*/
+
+uint8_t recchar(void)
+{
+    for (;;)
+    {
+        drainInput(0);
+        overrun();
+        if (rxHead != rxTail)
+        {
+            uint8_t datum = rxData[rxTail];
+            if (rxArrival[rxTail] > simClock)
+            {
+                waitClock += rxArrival[rxTail] - simClock;
+                simClock = rxArrival[rxTail];
+            }
+            rxTail = (rxTail+1) % RX_QUEUE;
+            pace();
+            return datum;
+        }
+        flushOutput();
+        pace();
+        drainInput(-1);
+    }
+}
+
+/*****************************************************************************/
+/** @brief Check for a received character
+
+@returns TRUE if a character is complete at the simulated time
+*/
+
+int rxReady(void)
+{
+    pace();
+    drainInput(0);
+    overrun();
+    return ((rxHead != rxTail) && (rxArrival[rxTail] <= simClock));
+}
+
+/*****************************************************************************/
+/** @brief Send a character
+
+The firmware waits for each character to go, so the clock is charged with the
+time of a character. A character delayed by an injected fault holds up the
+firmware as well, as if the UART could not get it away.
+
+@param[in] c the character
+*/
+
+void sendchar(const uint8_t c)
+{
+    uint8_t datum = c;
+    uint64_t hold;
+    uint8_t copies = injectFault(FAULT_TX,&datum,&hold);
+    if (hold > 0)
+    {
+        flushOutput();
+        advance(hold);
+    }
+    advance(characterTime());
+    for (uint8_t copy=0; copy < copies; copy++)
+    {
+        if (txCount >= sizeof(txData)) flushOutput();
+        txData[txCount++] = datum;
+    }
+    pace();
+}
+
+/*****************************************************************************/
+/** @brief Time of one character (start, eight data and stop bits) in ns */
+
+static uint64_t characterTime(void)
+{
+    return (10ULL*1000000000ULL)/timing.baud;
+}
+
+/*****************************************************************************/
+/** @brief Real time in ns */
+
+static uint64_t realTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec;
+}
+
+/*****************************************************************************/
+/** @brief Send the characters waiting for the pty */
+
+static void flushOutput(void)
+{
+    uint32_t sent = 0;
+    while (sent < txCount)
+    {
+        ssize_t n = write(master,txData+sent,txCount-sent);
+        if (n > 0) sent += n;
+        else if ((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+        {
+            perror("pty write");
+            exit(1);
+        }
+        else
+        {
+            struct pollfd out = { master, POLLOUT, 0 };
+            poll(&out,1,10);
+        }
+    }
+    txCount = 0;
+}
+
+/*****************************************************************************/
+/** @brief Take in whatever the PC has sent
+
+Each character is stamped with the simulated time at which its stop bit would
+have arrived. The PC sends characters back to back, so none can be complete
+sooner than one character time after the one before it. Injected faults are
+applied here, as the characters come off the line.
+
+@param[in] timeout Time to wait for something in ms, or -1 to wait for ever
+*/
+
+static void drainInput(const int timeout)
+{
+    struct pollfd in = { master, POLLIN, 0 };
+    int ready = poll(&in,1,timeout);
+    if (stopping) finish();
+    if (ready <= 0) return;
+    uint8_t data[1024];
+    ssize_t n = read(master,data,sizeof(data));
+    if ((n < 0) && (errno != EAGAIN) && (errno != EINTR) && (errno != EIO))
+    {
+        perror("pty read");
+        exit(1);
+    }
+/* EIO means the slave is not open, but we hold it, so this doesn't last */
+    if (n <= 0)
+    {
+        if (timeout != 0) usleep(1000);
+        return;
+    }
+    uint64_t now = simClock;
+    if (timing.scale > 0)
+    {
+        uint64_t real = (realTime() - realStart)/timing.scale;
+        if (real > now) now = real;
+    }
+    for (ssize_t i=0; i < n; i++)
+    {
+        uint64_t hold;
+        uint8_t copies = injectFault(FAULT_RX,&data[i],&hold);
+        lastArrival += hold;
+        for (uint8_t copy=0; copy < copies; copy++)
+        {
+            uint32_t next = (rxHead+1) % RX_QUEUE;
+            if (next == rxTail) break;              // PC is far ahead, drop
+            lastArrival += characterTime();
+            if (lastArrival < now + characterTime()) lastArrival = now + characterTime();
+            rxData[rxHead] = data[i];
+            rxArrival[rxHead] = lastArrival;
+            rxHead = next;
+        }
+    }
+}
+
+/*****************************************************************************/
+/** @brief Lose characters that have overrun the UART
+
+The UART holds rxDepth characters. Any more that are complete at the simulated
+time arrived with nowhere to go and are lost, as with the DOR flag on the AVR.
+*/
+
+static void overrun(void)
+{
+    uint32_t held = 0;
+    uint32_t index = rxTail;
+    while ((index != rxHead) && (rxArrival[index] <= simClock))
+    {
+        if (held < timing.rxDepth)
+        {
+            held++;
+            index = (index+1) % RX_QUEUE;
+        }
+        else
+        {
+/* Close up the queue over the lost character */
+            for (uint32_t i = index; i != rxHead; i = (i+1) % RX_QUEUE)
+            {
+                uint32_t next = (i+1) % RX_QUEUE;
+                if (next == rxHead) break;
+                rxData[i] = rxData[next];
+                rxArrival[i] = rxArrival[next];
+            }
+            rxHead = (rxHead+RX_QUEUE-1) % RX_QUEUE;
+            overruns++;
+            if (verbose) fprintf(stderr,"Overrun at %.3f ms\n",simClock/1e6);
+        }
+    }
+}
+
+/*****************************************************************************/
+/** @brief Keep real time in step with the simulated clock
+
+Sleeping is done in chunks of at least PACE_CHUNK, waiting on the pty so that
+characters arriving meanwhile are stamped as they come in. Output is sent
+before sleeping so that the PC sees it at about the right time.
+*/
+
+static void pace(void)
+{
+    if (timing.scale <= 0) return;
+    uint64_t due = realStart + simClock*timing.scale;
+    uint64_t now = realTime();
+    if (due < now + PACE_CHUNK) return;
+    flushOutput();
+    while ((now = realTime()) < due)
+        drainInput((due-now+NS_PER_MS-1)/NS_PER_MS);
+}
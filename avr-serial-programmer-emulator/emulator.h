@@ -0,0 +1,106 @@
+/*          Serial Programmer Emulator
+      Ken Sarkies ksarkies@internode.on.net
+            (www.jiggerjuice.net)
+
+File              : emulator.h
+Compiler          : gcc (C99 with POSIX)
+Target platform   : Linux
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <inttypes.h>
+
+#define TRUE 1
+#define FALSE 0
+#define  high(x) ((uint8_t) (x >> 8) & 0xFF)
+#define  low(x) ((uint8_t) (x & 0xFF))
+
+/* Simulated time is kept in nanoseconds */
+#define NS_PER_US   1000ULL
+#define NS_PER_MS   1000000ULL
+
+/* Defaults for the timing model. The firmware's own delays are charged as it
+makes them. The SPI overhead adds the time of the bit bang loop itself. */
+#define DEFAULT_BAUD        38400
+#define DEFAULT_SPI_OVERHEAD 0          // microseconds per SPI byte
+#define DEFAULT_FLASH_WRITE 4500        // microseconds for a FLASH page write
+#define DEFAULT_EEPROM_WRITE 9000       // microseconds for an EEPROM write
+#define DEFAULT_ERASE       9000        // microseconds for a chip erase
+#define DEFAULT_RX_DEPTH    2           // UDR plus the receive shift register
+
+/** @brief Properties of a simulated target part, as in the PC part table */
+struct Part
+{
+    const char *name;
+    uint8_t sig2;                   // Second and third signature bytes
+    uint8_t sig3;
+    uint8_t fPage;                  // FLASH page size in words, 0 if not paged
+    uint8_t ePage;                  // EEPROM page size in bytes, 0 if not paged
+    uint8_t busy;                   // Busy flag can be polled
+    uint8_t lockFuse;               // Lock and fuse access bits
+    uint32_t flash;                 // FLASH size in bytes
+    uint32_t eeprom;                // EEPROM size in bytes
+};
+
+/** @brief Timing model of the programmer and its links */
+struct Timing
+{
+    uint32_t baud;                  // Serial link rate
+    uint64_t spiOverhead;           // Added time of one SPI byte (ns)
+    uint64_t flashWrite;            // FLASH page or word write (ns)
+    uint64_t eepromWrite;           // EEPROM page or byte write (ns)
+    uint64_t erase;                 // Chip erase (ns)
+    uint32_t rxDepth;               // Bytes the UART can hold before overrun
+    double scale;                   // Real time per simulated time, 0 to run free
+};
+
+extern struct Timing timing;
+extern uint64_t simClock;           // Simulated time (ns)
+extern uint64_t waitClock;          // Simulated time spent waiting for the PC
+extern int verbose;
+
+/* emulator.c: the serial link and the simulated clock */
+void advance(const uint64_t ns);
+uint8_t recchar(void);
+void sendchar(const uint8_t c);
+int rxReady(void);
+
+/* target.c: the target on the SPI lines */
+const struct Part *findPart(const char *name);
+void listParts(void);
+void targetInit(const struct Part *part);
+void targetPins(const uint8_t reset, const uint8_t sck, const uint8_t mosi);
+uint8_t targetMiso(void);
+
+/* faults.c: faults injected on the serial link */
+#define FAULT_RX    1               // PC to programmer
+#define FAULT_TX    2               // Programmer to PC
+int setFaults(const char *spec, const uint32_t seed);
+uint8_t injectFault(const uint8_t direction, uint8_t *datum, uint64_t *hold);
+void printFaults(void);
+
+/* hal.c: the firmware's hardware */
+void printStats(void);
+
+/* serial-programmer.c: the firmware itself */
+int firmware(void);
@@ -0,0 +1,178 @@
+/**
+@file faults.c
+@brief Faults injected on the emulator's serial link
+
+@details Characters on the link can be dropped, duplicated, corrupted or
+delayed, each at a given rate per character, so that the PC program's retry and
+resynchronisation paths can be exercised and timed. The faults come from a
+seeded generator, so a run with the same seed and the same traffic sees the
+same faults in the same places.
+
+Faults are given as a comma separated list, for example
+
+    drop=0.001,dup=0.001,corrupt=0.002,delay=0.01,hold=20000,dir=rx
+
+- drop, dup, corrupt, delay: chance of each fault on a character, 0 to 1
+- hold: time a delayed character is held up in microseconds, default 10000
+- dir: rx (PC to programmer), tx (programmer to PC) or both, the default
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emulator.h"
+
+/* Time a delayed character is held up, in microseconds */
+#define DEFAULT_HOLD 10000
+
+/** @brief Fault rates and what was injected */
+struct Faults
+{
+    double drop;                    // Chance of each fault per character
+    double duplicate;
+    double corrupt;
+    double delay;
+    uint64_t hold;                  // Time a delayed character is held (ns)
+    uint8_t directions;             // FAULT_RX and FAULT_TX
+    uint32_t count[2][4];           // Faults injected by direction and kind
+};
+
+static struct Faults faults = { 0, 0, 0, 0, DEFAULT_HOLD*NS_PER_US,
+                                FAULT_RX | FAULT_TX, {{0}} };
+static uint32_t state = 1;          // Generator state, never zero
+static int enabled;
+
+static double chance(void);
+
+/*****************************************************************************/
+/** @brief Set up the faults
+
+@param[in] spec Comma separated list of faults and rates
+@param[in] seed Seed of the fault generator
+@returns FALSE if the list could not be understood
+*/
+
+int setFaults(const char *spec, const uint32_t seed)
+{
+    char list[256];
+    strncpy(list,spec,sizeof(list)-1);
+    list[sizeof(list)-1] = 0;
+    for (char *item = strtok(list,","); item != 0; item = strtok(0,","))
+    {
+        char *value = strchr(item,'=');
+        if (value == 0) return FALSE;
+        *value++ = 0;
+        if (strcmp(item,"drop") == 0) faults.drop = strtod(value,0);
+        else if (strcmp(item,"dup") == 0) faults.duplicate = strtod(value,0);
+        else if (strcmp(item,"corrupt") == 0) faults.corrupt = strtod(value,0);
+        else if (strcmp(item,"delay") == 0) faults.delay = strtod(value,0);
+        else if (strcmp(item,"hold") == 0) faults.hold = strtod(value,0)*NS_PER_US;
+        else if (strcmp(item,"dir") == 0)
+        {
+            if (strcmp(value,"rx") == 0) faults.directions = FAULT_RX;
+            else if (strcmp(value,"tx") == 0) faults.directions = FAULT_TX;
+            else if (strcmp(value,"both") == 0) faults.directions = FAULT_RX | FAULT_TX;
+            else return FALSE;
+        }
+        else return FALSE;
+    }
+    state = seed ? seed : 1;
+    enabled = TRUE;
+    return TRUE;
+}
+
+/*****************************************************************************/
+/** @brief Inject faults on a character
+
+The chance of each fault is tried in turn, and at most one is injected.
+
+@param[in] direction FAULT_RX or FAULT_TX
+@param[in,out] datum The character, changed if it is corrupted
+@param[out] hold Time the character is held up (ns), 0 if it is not
+@returns the number of copies of the character to pass on, 0 if it is dropped
+*/
+
+uint8_t injectFault(const uint8_t direction, uint8_t *datum, uint64_t *hold)
+{
+    *hold = 0;
+    if (! enabled || ! (faults.directions & direction)) return 1;
+    uint32_t *count = faults.count[direction == FAULT_TX];
+    double roll = chance();
+    if ((roll -= faults.drop) < 0)
+    {
+        count[0]++;
+        if (verbose) fprintf(stderr,"%10.3f ms  drop %02X\n",simClock/1e6,*datum);
+        return 0;
+    }
+    if ((roll -= faults.duplicate) < 0)
+    {
+        count[1]++;
+        if (verbose) fprintf(stderr,"%10.3f ms  duplicate %02X\n",simClock/1e6,*datum);
+        return 2;
+    }
+    if ((roll -= faults.corrupt) < 0)
+    {
+        count[2]++;
+        uint8_t bit = chance()*8;
+        if (verbose) fprintf(stderr,"%10.3f ms  corrupt %02X bit %u\n",
+                             simClock/1e6,*datum,bit);
+        *datum ^= (1 << bit);
+        return 1;
+    }
+    if ((roll -= faults.delay) < 0)
+    {
+        count[3]++;
+        if (verbose) fprintf(stderr,"%10.3f ms  delay %02X\n",simClock/1e6,*datum);
+        *hold = faults.hold;
+    }
+    return 1;
+}
+
+/*****************************************************************************/
+/** @brief Report the faults injected on stderr */
+
+void printFaults(void)
+{
+    if (! enabled) return;
+    const char *direction[] = {"PC to programmer","Programmer to PC"};
+    for (int n=0; n < 2; n++)
+    {
+        fprintf(stderr,"%s: %u dropped, %u duplicated, %u corrupted, %u delayed\n",
+                direction[n],faults.count[n][0],faults.count[n][1],
+                faults.count[n][2],faults.count[n][3]);
+    }
+}
+
+/*****************************************************************************/
+/** @brief Next number from the generator (xorshift32)
+
+@returns a number from 0 up to but not including 1
+*/
+
+static double chance(void)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state/4294967296.0;
+}
@@ -0,0 +1,245 @@
+/**
+@file hal.c
+@brief Hardware of the firmware when it runs in the emulator
+
+@details This provides what hal.h asks for when the firmware is built with
+EMULATOR defined. The UART is the emulator's pty link. PORTB and DDRB are kept
+here, and every change is passed on to the simulated target as the levels on
+its RESET, SCK and MOSI lines. A line that is not driven is taken as low,
+except RESET which has a pull-up on the target. The firmware's delays are
+charged to the simulated clock.
+
+Each SCK cycle is counted, and the cycles and busy time are totalled for each
+command, so that firmware changes can be measured in SPI traffic as well as in
+time.
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include "emulator.h"
+#include "hal.h"
+#include "serial-programmer.h"
+
+/** @brief Totals for one command character */
+struct CommandStats
+{
+    uint32_t count;                 // Times the command was given
+    uint64_t cycles;                // SCK cycles
+    uint64_t busy;                  // Simulated time not spent waiting (ns)
+};
+
+static uint8_t port;                // PORTB as written by the firmware
+static uint8_t ddr;                 // DDRB
+static uint8_t sckLevel;            // Last SCK level seen by the target
+static uint64_t cycles;             // SCK cycles so far
+static struct CommandStats commandStats[256];
+static int current = -1;            // Command being carried out
+static uint64_t startClock;         // Clocks and cycles when it started
+static uint64_t startWait;
+static uint64_t startCycles;
+
+static uint8_t line(const uint8_t pin, const uint8_t undriven);
+static void update(void);
+static void endCommand(void);
+
+/*****************************************************************************/
+/** @brief Nothing to do, the link is opened before the firmware starts */
+
+void initHardware(void)
+{
+}
+
+/*****************************************************************************/
+/** @brief A character is waiting to be read */
+
+uint8_t charReady(void)
+{
+    return rxReady();
+}
+
+/*****************************************************************************/
+/** @brief Receive a character. A pty doesn't pass on a BREAK. */
+
+uint8_t recbreak(uint8_t *datum)
+{
+    *datum = recchar();
+    return FALSE;
+}
+
+/*****************************************************************************/
+/** @brief Make lines outputs */
+
+void pinsOutput(const uint8_t mask)
+{
+    ddr |= mask;
+    update();
+}
+
+/*****************************************************************************/
+/** @brief Make lines inputs */
+
+void pinsInput(const uint8_t mask)
+{
+    ddr &= ~mask;
+    update();
+}
+
+/*****************************************************************************/
+/** @brief Set several lines high */
+
+void pinsHigh(const uint8_t mask)
+{
+    port |= mask;
+    update();
+}
+
+/*****************************************************************************/
+/** @brief Set a line high */
+
+void pinHigh(const uint8_t pin)
+{
+    port |= _BV(pin);
+    update();
+}
+
+/*****************************************************************************/
+/** @brief Set a line low */
+
+void pinLow(const uint8_t pin)
+{
+    port &= ~_BV(pin);
+    update();
+}
+
+/*****************************************************************************/
+/** @brief Read a line. Only MISO is connected to anything. */
+
+uint8_t pinRead(const uint8_t pin)
+{
+    if (pin == MISO) return targetMiso();
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Charge a firmware delay to the simulated clock */
+
+void _delay_us(const double us)
+{
+    advance(us*NS_PER_US);
+}
+
+/*****************************************************************************/
+/** @brief CRC16 XMODEM update, as in avr-libc */
+
+uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+    crc ^= ((uint16_t)data << 8);
+    for (uint8_t i=0; i < 8; i++)
+    {
+        if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+        else crc <<= 1;
+    }
+    return crc;
+}
+
+/*****************************************************************************/
+/** @brief Note the start of a command
+
+The previous command is taken to have run until now.
+
+@param[in] command The command character
+*/
+
+void traceCommand(const uint8_t command)
+{
+    endCommand();
+    current = command;
+    commandStats[command].count++;
+    if (verbose) fprintf(stderr,"%10.3f ms  '%c' %02X\n",simClock/1e6,
+                         ((command >= ' ') && (command < 0x7F)) ? command : '.',
+                         command);
+}
+
+/*****************************************************************************/
+/** @brief Report the totals for each command on stderr */
+
+void printStats(void)
+{
+    endCommand();
+    current = -1;
+    fprintf(stderr,"Cmd   Count   SCK cycles/cmd   Busy ms/cmd   Busy ms total\n");
+    for (int n=0; n < 256; n++)
+    {
+        struct CommandStats *stats = &commandStats[n];
+        if (stats->count == 0) continue;
+        fprintf(stderr," %c  %7u   %14.1f   %11.3f   %13.3f\n",
+                ((n >= ' ') && (n < 0x7F)) ? n : '.',stats->count,
+                (double)stats->cycles/stats->count,
+                stats->busy/1e6/stats->count,stats->busy/1e6);
+    }
+}
+
+/*****************************************************************************/
+/** @brief Add the time and cycles since the last command started to its totals */
+
+static void endCommand(void)
+{
+    if (current >= 0)
+    {
+        commandStats[current].cycles += cycles - startCycles;
+        commandStats[current].busy += (simClock - startClock) - (waitClock - startWait);
+    }
+    startClock = simClock;
+    startWait = waitClock;
+    startCycles = cycles;
+}
+
+/*****************************************************************************/
+/** @brief Level on a line
+
+@param[in] pin      PORTB bit
+@param[in] undriven Level when the line is an input
+*/
+
+static uint8_t line(const uint8_t pin, const uint8_t undriven)
+{
+    if (ddr & _BV(pin)) return (port >> pin) & 1;
+    return undriven;
+}
+
+/*****************************************************************************/
+/** @brief Pass the line levels on to the target, counting SCK cycles
+
+The time of the bit bang loop beyond its delays is charged on each cycle.
+*/
+
+static void update(void)
+{
+    uint8_t sck = line(SCK,0);
+    if (sck && ! sckLevel)
+    {
+        cycles++;
+        advance(timing.spiOverhead/8);
+    }
+    sckLevel = sck;
+    targetPins(line(RESET,1),sck,line(MOSI,0));
+}
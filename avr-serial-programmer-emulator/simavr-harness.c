@@ -0,0 +1,396 @@
+/**
+@file simavr-harness.c
+@brief Cycle counts of the compiled firmware under simavr
+
+@details The emulator runs the firmware source natively, so it shows SPI traffic
+but not what the AVR spends on instructions: the bit bang loop, the polled
+sendchar, or the lookups in FLASH. This harness runs the compiled firmware hex
+in the simavr instruction set simulator instead, with the simulated target of
+target.c on its PORTB programming lines.
+
+By default it drives the firmware itself and reports the cycles taken by a
+'P' entry, a 'B' page load and a 'g' read per byte. Each is also given less
+the time its characters take on the serial link, which is what the firmware
+itself costs:
+
+    simavr-harness -f ../avr-serial-programmer-4313/serial-programmer.hex
+
+With -p it opens a pty instead, for the PC program to use as it would the
+programmer.
+
+Options:
+- -f file     firmware hex file
+- -m mcu      simavr core, default attiny4313
+- -c hz       programmer clock, default 8000000
+- -d part     target part, default ATMega328
+- -n pages    pages to load and read back in the benchmark, default 8
+- -p          run on a pty instead of the benchmark
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sim_avr.h>
+#include <sim_hex.h>
+#include <avr_uart.h>
+#include <avr_ioport.h>
+#include "emulator.h"
+
+/* Programming lines on PORTB, as in serial-programmer.h */
+#define SCK         7
+#define MISO        6
+#define MOSI        5
+#define RESET       4
+
+/* UART rate of the firmware (BRREG_VALUE 12 at 8MHz) */
+#define FIRMWARE_BAUD   38400
+/* Cycles to give up after when the firmware doesn't answer */
+#define ANSWER_LIMIT    100000000ULL
+#define QUEUE_SIZE      1024
+
+struct Timing timing = {
+    FIRMWARE_BAUD,
+    0,
+    DEFAULT_FLASH_WRITE*NS_PER_US,
+    DEFAULT_EEPROM_WRITE*NS_PER_US,
+    DEFAULT_ERASE*NS_PER_US,
+    DEFAULT_RX_DEPTH,
+    0
+};
+uint64_t simClock;                  // Simulated time (ns), from the AVR cycles
+int verbose;
+
+static avr_t *avr;
+static avr_irq_t *uartIn;           // Characters to the firmware
+static avr_irq_t *misoIn;           // MISO input pin
+static uint8_t xon = TRUE;          // UART can take another character
+static uint8_t toFirmware[QUEUE_SIZE];
+static uint32_t toHead, toTail;
+static uint8_t fromFirmware[QUEUE_SIZE];
+static uint32_t fromCount;
+static uint8_t port;                // PORTB and DDRB as written
+static uint8_t ddr;
+static int pty = -1;
+
+static void pump(void);
+static void update(void);
+static void send(const uint8_t *data, const uint32_t length);
+static uint64_t exchange(const uint8_t *data, const uint32_t length,
+                         const uint32_t answer);
+static void report(const char *what, const uint64_t cycles,
+                   const uint32_t characters, const uint32_t per);
+static void benchmark(const uint32_t pages);
+static void runPty(void);
+
+/*****************************************************************************/
+/** @brief simavr callbacks */
+
+static void uartOutput(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if (pty >= 0)
+    {
+        uint8_t datum = value;
+        if (write(pty,&datum,1) < 0) perror("pty write");
+    }
+    else if (fromCount < QUEUE_SIZE) fromFirmware[fromCount++] = value;
+}
+
+static void uartXon(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    xon = TRUE;
+    pump();
+}
+
+static void uartXoff(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    xon = FALSE;
+}
+
+static void portWrite(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    port = value;
+    update();
+}
+
+static void ddrWrite(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    ddr = value;
+    update();
+}
+
+/*****************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    const char *file = "../avr-serial-programmer-4313/serial-programmer.hex";
+    const char *mcu = "attiny4313";
+    const struct Part *device = findPart("ATMega328");
+    uint32_t frequency = 8000000;
+    uint32_t pages = 8;
+    int usePty = FALSE;
+    int c;
+    while ((c = getopt(argc,argv,"f:m:c:d:n:p")) != -1)
+    {
+        switch (c)
+        {
+            case 'f': file = optarg; break;
+            case 'm': mcu = optarg; break;
+            case 'c': frequency = strtoul(optarg,0,0); break;
+            case 'd':
+                device = findPart(optarg);
+                if (device == 0)
+                {
+                    fprintf(stderr,"Unknown part %s\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'n': pages = strtoul(optarg,0,0); break;
+            case 'p': usePty = TRUE; break;
+            default:
+                fprintf(stderr,"Usage: %s [-f hexfile] [-m mcu] [-c hz] "
+                        "[-d part] [-n pages] [-p]\n",argv[0]);
+                return 1;
+        }
+    }
+    avr = avr_make_mcu_by_name(mcu);
+    if (avr == 0)
+    {
+        fprintf(stderr,"simavr has no core %s\n",mcu);
+        return 1;
+    }
+    avr_init(avr);
+    avr->frequency = frequency;
+    uint32_t size, base;
+    uint8_t *code = read_ihex_file(file,&size,&base);
+    if ((code == 0) || (base + size > avr->flashend + 1))
+    {
+        fprintf(stderr,"Cannot load %s\n",file);
+        return 1;
+    }
+    memcpy(avr->flash + base,code,size);
+    free(code);
+    avr->pc = base;
+    avr->codeend = avr->flashend;
+    targetInit(device);
+
+/* The UART goes to us rather than to stdout */
+    uint32_t flags = 0;
+    avr_ioctl(avr,AVR_IOCTL_UART_GET_FLAGS('0'),&flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr,AVR_IOCTL_UART_SET_FLAGS('0'),&flags);
+    uartIn = avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),UART_IRQ_INPUT);
+    avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),
+                            UART_IRQ_OUTPUT),uartOutput,0);
+    avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),
+                            UART_IRQ_OUT_XON),uartXon,0);
+    avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),
+                            UART_IRQ_OUT_XOFF),uartXoff,0);
+    avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_IOPORT_GETIRQ('B'),
+                            IOPORT_IRQ_REG_PORT),portWrite,0);
+    avr_irq_register_notify(avr_io_getirq(avr,AVR_IOCTL_IOPORT_GETIRQ('B'),
+                            IOPORT_IRQ_DIRECTION_ALL),ddrWrite,0);
+    misoIn = avr_io_getirq(avr,AVR_IOCTL_IOPORT_GETIRQ('B'),IOPORT_IRQ_PIN0+MISO);
+
+    if (usePty) runPty();
+    else benchmark(pages);
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Pass the programming lines to the target and MISO back
+
+An undriven line is low, except RESET which the target pulls up.
+*/
+
+static void update(void)
+{
+    simClock = (avr->cycle*1000000000ULL)/avr->frequency;
+    uint8_t reset = ((ddr >> RESET) & 1) ? ((port >> RESET) & 1) : 1;
+    uint8_t sck = ((ddr >> SCK) & 1) ? ((port >> SCK) & 1) : 0;
+    uint8_t mosi = ((ddr >> MOSI) & 1) ? ((port >> MOSI) & 1) : 0;
+    targetPins(reset,sck,mosi);
+    avr_raise_irq(misoIn,targetMiso());
+}
+
+/*****************************************************************************/
+/** @brief Feed queued characters to the UART while it will take them */
+
+static void pump(void)
+{
+    while (xon && (toTail != toHead))
+    {
+        uint8_t datum = toFirmware[toTail];
+        toTail = (toTail+1) % QUEUE_SIZE;
+        avr_raise_irq(uartIn,datum);
+    }
+}
+
+/*****************************************************************************/
+/** @brief Queue characters for the firmware */
+
+static void send(const uint8_t *data, const uint32_t length)
+{
+    for (uint32_t n=0; n < length; n++)
+    {
+        toFirmware[toHead] = data[n];
+        toHead = (toHead+1) % QUEUE_SIZE;
+    }
+    pump();
+}
+
+/*****************************************************************************/
+/** @brief Send a command and run until it is answered
+
+@param[in] data   Command and its parameters
+@param[in] length Number of characters
+@param[in] answer Number of characters in the answer
+@returns the cycles taken, from the first character sent to the last received
+*/
+
+static uint64_t exchange(const uint8_t *data, const uint32_t length,
+                         const uint32_t answer)
+{
+    fromCount = 0;
+    uint64_t start = avr->cycle;
+    send(data,length);
+    while ((fromCount < answer) && (avr->cycle - start < ANSWER_LIMIT))
+    {
+        int state = avr_run(avr);
+        if ((state == cpu_Done) || (state == cpu_Crashed))
+        {
+            fprintf(stderr,"Firmware stopped\n");
+            exit(1);
+        }
+    }
+    if (fromCount < answer)
+    {
+        fprintf(stderr,"No answer to '%c'\n",data[0]);
+        exit(1);
+    }
+    return avr->cycle - start;
+}
+
+/*****************************************************************************/
+/** @brief Print a figure, in total and less the serial link time
+
+@param[in] what       Name of the figure
+@param[in] cycles     Cycles taken
+@param[in] characters Characters that crossed the link meanwhile
+@param[in] per        Number of units the figure is divided by
+*/
+
+static void report(const char *what, const uint64_t cycles,
+                   const uint32_t characters, const uint32_t per)
+{
+    uint64_t serial = (uint64_t)characters*10*avr->frequency/FIRMWARE_BAUD;
+    double firmware = (cycles > serial) ? (double)(cycles - serial) : 0;
+    printf("%-14s %12.1f cycles   %12.1f less serial\n",what,
+           (double)cycles/per,firmware/per);
+}
+
+/*****************************************************************************/
+/** @brief Measure programming mode entry, page loads and block reads */
+
+static void benchmark(const uint32_t pages)
+{
+    uint8_t command[4 + 256];
+    uint64_t cycles = exchange((const uint8_t *)"P",1,1);
+    if (fromFirmware[0] != '\r')
+    {
+        fprintf(stderr,"Target not recognized\n");
+        exit(1);
+    }
+    report("'P' entry",cycles,2,1);
+    exchange((const uint8_t *)"b",1,3);
+    uint32_t pageSize = (fromFirmware[1] << 8) | fromFirmware[2];
+    if ((fromFirmware[0] != 'Y') || (pageSize == 0) || (pageSize > 256))
+    {
+        fprintf(stderr,"Block mode not offered\n");
+        exit(1);
+    }
+    exchange((const uint8_t *)"e",1,1);
+    exchange((const uint8_t *)"A\x00\x00",3,1);
+    uint64_t total = 0;
+    for (uint32_t page=0; page < pages; page++)
+    {
+        command[0] = 'B';
+        command[1] = high(pageSize);
+        command[2] = low(pageSize);
+        command[3] = 'F';
+        for (uint32_t n=0; n < pageSize; n++) command[4+n] = rand();
+        total += exchange(command,4+pageSize,1);
+    }
+    report("'B' page",total,pages*(4+pageSize+1),pages);
+    exchange((const uint8_t *)"A\x00\x00",3,1);
+    uint32_t length = pageSize*pages;
+    if (length > QUEUE_SIZE) length = QUEUE_SIZE;
+    command[0] = 'g';
+    command[1] = high(length);
+    command[2] = low(length);
+    command[3] = 'F';
+    cycles = exchange(command,4,length);
+    report("'g' byte",cycles,4+length,length);
+}
+
+/*****************************************************************************/
+/** @brief Run the firmware on a pty until interrupted */
+
+static void runPty(void)
+{
+    pty = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((pty < 0) || (grantpt(pty) < 0) || (unlockpt(pty) < 0))
+    {
+        perror("Cannot open a pty");
+        exit(1);
+    }
+    const char *name = ptsname(pty);
+    int slave = open(name,O_RDWR | O_NOCTTY);
+    struct termios settings;
+    if ((slave < 0) || (tcgetattr(slave,&settings) < 0))
+    {
+        perror("Cannot open the pty slave");
+        exit(1);
+    }
+    cfmakeraw(&settings);
+    tcsetattr(slave,TCSANOW,&settings);
+    fcntl(pty,F_SETFL,fcntl(pty,F_GETFL) | O_NONBLOCK);
+    printf("%s\n",name);
+    fflush(stdout);
+    for (uint32_t n=0; ; n++)
+    {
+        int state = avr_run(avr);
+        if ((state == cpu_Done) || (state == cpu_Crashed)) break;
+        if ((n % 1000) != 0) continue;
+        uint8_t data[QUEUE_SIZE/2];
+        uint32_t room = (toTail + QUEUE_SIZE - toHead - 1) % QUEUE_SIZE;
+        if (room > sizeof(data)) room = sizeof(data);
+        ssize_t count = read(pty,data,room);
+        if (count > 0) send(data,count);
+    }
+    fprintf(stderr,"Firmware stopped\n");
+}
@@ -0,0 +1,329 @@
+/**
+@file target.c
+@brief Simulated AVR target on the ISP lines
+
+@details The target is modelled at the pin level. The programmer drives RESET,
+SCK and MOSI and reads MISO, exactly as the firmware bit bangs them, and the
+target decodes the four byte serial programming instructions from the data
+sheets.
+
+As in SPI mode 0, MOSI is sampled on the rising edge of SCK and MISO changes on
+the falling edge. The second and third bytes of an instruction are echoed one
+byte late, and reads return their value in the fourth byte. Holding RESET low
+restarts the bit count, which is how the programmer synchronizes.
+
+FLASH writes can only clear bits, so a page written without an erase comes out
+as the AND of the old and new contents, as on a real part. Writes take the
+times given in the timing model. While a write is in progress the target
+ignores further write instructions and memory reads return 0xFF, so that the
+firmware's busy and data polling are exercised.
+
+Lock bits are stored but do not protect the memories.
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "emulator.h"
+
+/*****************************************************************************/
+/** @brief Array of parts and properties
+
+This is the part table of the PC program, with the page sizes in the units the
+firmware uses. The first signature byte is always 1E.
+*/
+#define NUMPARTS 19
+static const struct Part part[NUMPARTS] = {
+/* Name,       Sig 2, Sig 3, FPage, EPage, Busy, Lock/Fuse, Flash, EEPROM */
+{ "AT90S2313",  0x91,  0x01,    0,    0,   FALSE,  0x10,    2048,   128 },
+{ "ATTiny24",   0x91,  0x0B,   16,    4,   TRUE,   0xFF,    2048,   128 },
+{ "ATTiny26",   0x91,  0x09,   16,    0,   FALSE,  0x77,    2048,   128 },
+{ "ATTiny2313", 0x91,  0x0A,   16,    4,   TRUE,   0xFF,    2048,   128 },
+{ "ATTiny261",  0x91,  0x0C,   16,    4,   TRUE,   0xFF,    2048,   128 },
+{ "ATTiny4313", 0x92,  0x0D,   32,    4,   TRUE,   0xFF,    4096,   256 },
+{ "ATTiny44",   0x92,  0x07,   32,    4,   TRUE,   0xFF,    4096,   256 },
+{ "ATMega48",   0x92,  0x05,   32,    4,   TRUE,   0xFF,    4096,   256 },
+{ "ATTiny461",  0x92,  0x08,   32,    4,   TRUE,   0xFF,    4096,   256 },
+{ "ATTiny441",  0x92,  0x15,    8,    4,   TRUE,   0xFF,    4096,   256 },
+{ "ATTiny84",   0x93,  0x0C,   32,    4,   TRUE,   0xFF,    8192,   512 },
+{ "ATMega8535", 0x93,  0x08,   32,    0,   FALSE,  0x77,    8192,   512 },
+{ "ATMega88",   0x93,  0x0A,   32,    4,   TRUE,   0xFF,    8192,   512 },
+{ "ATTiny861",  0x93,  0x0D,   32,    4,   TRUE,   0xFF,    8192,   512 },
+{ "ATTiny841",  0x93,  0x15,    8,    4,   TRUE,   0xFF,    8192,   512 },
+{ "ATMega16",   0x94,  0x03,   64,    4,   TRUE,   0x77,   16384,   512 },
+{ "ATMega168",  0x94,  0x06,   64,    4,   TRUE,   0xFF,   16384,   512 },
+{ "ATMega328",  0x95,  0x0F,   64,    4,   TRUE,   0xFF,   32768,  1024 },
+{ "ATMega32",   0x95,  0x02,   64,    0,   FALSE,  0x77,   32768,  1024 }
+};
+
+/*****************************************************************************/
+
+static const struct Part *device;   // Part being simulated
+static uint8_t *flash;              // FLASH contents
+static uint8_t *eeprom;             // EEPROM contents
+static uint8_t *flashPage;          // FLASH page buffer
+static uint8_t eepromPage[256];     // EEPROM page buffer
+static uint8_t eepromLoaded[256];   // EEPROM page buffer bytes loaded
+static uint8_t fuse = 0x62;         // Fuse bytes at their factory settings
+static uint8_t highFuse = 0xDF;
+static uint8_t extendedFuse = 0xFF;
+static uint8_t lock = 0xFF;
+static uint64_t busyUntil;          // End of the write in progress
+static uint8_t enabled;             // Serial programming has been enabled
+static uint8_t resetPin = TRUE;     // Last pin states
+static uint8_t sckPin;
+static uint8_t instruction[4];      // Bytes of the current instruction
+static uint8_t byteCount;           // Bytes received of the instruction
+static uint8_t bitCount;            // Bits received of the byte
+static uint8_t inShift;             // Byte being received
+static uint8_t outShift;            // Byte being sent, MSB on MISO
+
+static uint8_t readInstruction(void);
+static void writeInstruction(void);
+
+/*****************************************************************************/
+/** @brief Find a part by name
+
+@param[in] name Part name, in any case
+@returns the part, or 0 if not known
+*/
+
+const struct Part *findPart(const char *name)
+{
+    for (uint8_t n=0; n < NUMPARTS; n++)
+        if (strcasecmp(name,part[n].name) == 0) return &part[n];
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief List the parts that can be simulated */
+
+void listParts(void)
+{
+    for (uint8_t n=0; n < NUMPARTS; n++)
+        printf("%-12s FLASH %5u EEPROM %4u FLASH page %2u words\n",
+               part[n].name,part[n].flash,part[n].eeprom,part[n].fPage);
+}
+
+/*****************************************************************************/
+/** @brief Power up a target
+
+The memories start off erased.
+
+@param[in] type The part to simulate
+*/
+
+void targetInit(const struct Part *type)
+{
+    device = type;
+    flash = malloc(device->flash);
+    eeprom = malloc(device->eeprom);
+    flashPage = malloc(device->fPage*2+2);
+    if ((flash == 0) || (eeprom == 0) || (flashPage == 0))
+    {
+        fprintf(stderr,"Out of memory for the target\n");
+        exit(1);
+    }
+    memset(flash,0xFF,device->flash);
+    memset(eeprom,0xFF,device->eeprom);
+    memset(flashPage,0xFF,device->fPage*2+2);
+}
+
+/*****************************************************************************/
+/** @brief Drive the programming lines
+
+Called whenever the programmer changes an output. RESET is active low. Raising
+it lets the target run and drops it out of programming mode. While it is low,
+the target clocks in MOSI on each rising edge of SCK and shifts out MISO on each
+falling edge. A complete instruction is carried out at the end of its fourth
+byte.
+
+@param[in] reset State of the RESET line
+@param[in] sck   State of the SCK line
+@param[in] mosi  State of the MOSI line
+*/
+
+void targetPins(const uint8_t reset, const uint8_t sck, const uint8_t mosi)
+{
+    if (reset)
+    {
+        enabled = FALSE;
+        byteCount = 0;
+        bitCount = 0;
+        outShift = 0;
+    }
+    else if (resetPin || (sck == sckPin)) {}        // No clock edge
+    else if (sck)                                   // Rising edge
+    {
+        inShift = (inShift << 1) | (mosi ? 1 : 0);
+        bitCount++;
+    }
+    else if (bitCount < 8) outShift <<= 1;          // Falling edge
+    else
+    {
+        instruction[byteCount++] = inShift;
+        bitCount = 0;
+/* The previous byte is echoed, except for the last where a read is answered */
+        outShift = inShift;
+        if (byteCount == 3) outShift = readInstruction();
+        else if (byteCount == 4)
+        {
+            writeInstruction();
+            byteCount = 0;
+            outShift = 0;
+        }
+    }
+    resetPin = reset;
+    sckPin = sck;
+}
+
+/*****************************************************************************/
+/** @brief State of the MISO line
+
+@returns the bit of the target's response currently on MISO
+*/
+
+uint8_t targetMiso(void)
+{
+    return (outShift >> 7) & 1;
+}
+
+/*****************************************************************************/
+/** @brief Answer a read instruction
+
+Called once the first three bytes are in, to find what goes out in the fourth.
+
+@returns the byte read, or 0 if this is not a read
+*/
+
+static uint8_t readInstruction(void)
+{
+    if (! enabled) return 0;
+    uint8_t busy = (simClock < busyUntil);
+    uint16_t location = (instruction[1] << 8) | instruction[2];
+    switch (instruction[0])
+    {
+        case 0x30:                                  // Signature
+            if ((instruction[2] & 0x03) == 0) return 0x1E;
+            if ((instruction[2] & 0x03) == 1) return device->sig2;
+            if ((instruction[2] & 0x03) == 2) return device->sig3;
+            return 0xFF;
+        case 0x20:                                  // FLASH low byte
+            if (busy) return 0xFF;
+            return flash[(location*2) & (device->flash-1)];
+        case 0x28:                                  // FLASH high byte
+            if (busy) return 0xFF;
+            return flash[(location*2+1) & (device->flash-1)];
+        case 0xA0:                                  // EEPROM byte
+            if (busy) return 0xFF;
+            return eeprom[location & (device->eeprom-1)];
+        case 0xF0:                                  // Busy flag
+            return (device->busy && busy) ? 0x01 : 0x00;
+        case 0x50:                                  // Fuse, Extended Fuse
+            return (instruction[1] == 0x08) ? extendedFuse : fuse;
+        case 0x58:                                  // Lock, High Fuse
+            return (instruction[1] == 0x08) ? highFuse : lock;
+    }
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Carry out a write instruction
+
+Called once all four bytes are in. Until serial programming is enabled, only
+the enable instruction is recognized. Writes are dropped while the target is
+busy.
+*/
+
+static void writeInstruction(void)
+{
+    if ((instruction[0] == 0xAC) && (instruction[1] == 0x53))
+    {
+        enabled = TRUE;
+        return;
+    }
+    if ((! enabled) || (simClock < busyUntil)) return;
+    uint16_t location = (instruction[1] << 8) | instruction[2];
+    uint8_t datum = instruction[3];
+    uint16_t pageMask = (device->fPage > 0) ? device->fPage-1 : 0;
+    switch (instruction[0])
+    {
+        case 0x40:                                  // FLASH low byte
+        case 0x48:                                  // FLASH high byte
+        {
+            uint8_t upper = (instruction[0] == 0x48);
+            if (device->fPage > 0)
+                flashPage[((location & pageMask)*2) + upper] = datum;
+            else
+            {
+                flash[(location*2 + upper) & (device->flash-1)] &= datum;
+                busyUntil = simClock + timing.flashWrite;
+            }
+            break;
+        }
+        case 0x4C:                                  // Write FLASH page
+        {
+            uint32_t base = ((location & ~pageMask)*2) & (device->flash-1);
+            for (uint16_t n=0; n < device->fPage*2; n++)
+                flash[base+n] &= flashPage[n];
+            memset(flashPage,0xFF,device->fPage*2);
+            busyUntil = simClock + timing.flashWrite;
+            break;
+        }
+        case 0xC0:                                  // EEPROM byte
+            eeprom[location & (device->eeprom-1)] = datum;
+            busyUntil = simClock + timing.eepromWrite;
+            break;
+        case 0xC1:                                  // Load EEPROM page
+            if (device->ePage > 0)
+            {
+                eepromPage[instruction[2] & (device->ePage-1)] = datum;
+                eepromLoaded[instruction[2] & (device->ePage-1)] = TRUE;
+            }
+            break;
+        case 0xC2:                                  // Write EEPROM page
+            if (device->ePage > 0)
+            {
+                uint16_t base = location & ~(device->ePage-1) & (device->eeprom-1);
+                for (uint8_t n=0; n < device->ePage; n++)
+                    if (eepromLoaded[n]) eeprom[base+n] = eepromPage[n];
+                memset(eepromLoaded,FALSE,sizeof(eepromLoaded));
+                busyUntil = simClock + timing.eepromWrite;
+            }
+            break;
+        case 0xAC:
+            if (instruction[1] == 0x80)             // Chip erase
+            {
+                memset(flash,0xFF,device->flash);
+                memset(eeprom,0xFF,device->eeprom);
+                lock = 0xFF;
+                busyUntil = simClock + timing.erase;
+            }
+            else if (instruction[1] == 0xA0) fuse = datum;
+            else if (instruction[1] == 0xA8) highFuse = datum;
+            else if (instruction[1] == 0xA4) extendedFuse = datum;
+            else if (instruction[1] == 0xE0) lock &= datum;     // Only erase sets
+            break;
+    }
+}
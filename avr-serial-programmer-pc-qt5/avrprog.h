@@ -0,0 +1,142 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. C interface
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef AVRPROG_H
+#define AVRPROG_H
+
+/** @brief C interface to the programming engine.
+
+The programmer is opened once, which synchronizes with it and identifies the
+device, and then any number of operations can be done over the same connection
+before it is closed. This suits test fixture software that programs many boards
+without starting a process for each.
+
+Only the FLASH memory is supported, at addresses below 64K. Every call except
+avrprog_version() and avrprog_error() returns one of the AVRPROG_ results, which
+have the same values as the exit status of the command line program. After a
+failure avrprog_error() describes what went wrong, given a null handle if the
+open itself failed, as no handle is given back then.
+
+A Qt core application object is made on the first open if the calling program
+doesn't have one. A handle must only be used from the thread that opened it.
+
+@code
+    avrprog* programmer;
+    if (avrprog_open("ttyUSB0",38400,0,&programmer) == AVRPROG_OK)
+    {
+        result = avrprog_program(programmer,0,image,imageLength,AVRPROG_VERIFY);
+        avrprog_close(programmer);
+    }
+    else fprintf(stderr,"%s\n",avrprog_error(programmer));
+@endcode
+*/
+
+#if defined(AVRPROG_LIBRARY)
+#define AVRPROG_EXPORT __attribute__((visibility("default")))
+#else
+#define AVRPROG_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version of this interface, raised when a call or structure changes */
+#define AVRPROG_API_VERSION     1
+
+/* Results of the calls */
+#define AVRPROG_OK              0   /* Success */
+#define AVRPROG_ERR_ARGUMENT    1   /* Bad argument, or address out of range */
+#define AVRPROG_ERR_NOPROGRAMMER 2  /* The programmer could not be contacted */
+#define AVRPROG_ERR_LINK        4   /* The programmer stopped responding */
+#define AVRPROG_ERR_VERIFY      5   /* The memory doesn't hold the data */
+#define AVRPROG_ERR_UNSUPPORTED 6   /* The device or programmer can't do it */
+
+/* Options when opening */
+#define AVRPROG_DEBUG           0x01    /* Log the protocol on stderr */
+#define AVRPROG_WORDMODE        0x02    /* Don't use block transfers */
+
+/* Options when programming */
+#define AVRPROG_VERIFY          0x01    /* Read back and check the data */
+#define AVRPROG_FORCE           0x02    /* Program even if it is already there */
+
+/* Selection of the lock and fuse bytes, in the order the part table uses */
+#define AVRPROG_LOCK            0x01
+#define AVRPROG_FUSE_LOW        0x02
+#define AVRPROG_FUSE_HIGH       0x04
+#define AVRPROG_FUSE_EXTENDED   0x08
+
+typedef struct avrprog avrprog;     /* Open connection to a programmer */
+
+/* What was found when the programmer was opened */
+typedef struct
+{
+    unsigned char signature[3];     /* Signature bytes, as read */
+    char device[16];                /* Device name, empty if unknown */
+    char programmer[8];             /* Programmer identifier */
+    unsigned int baudrate;          /* Baud rate the programmer answered at */
+    unsigned int flash_size;        /* FLASH size in bytes, zero if unknown */
+    unsigned int eeprom_size;       /* EEPROM size in bytes */
+    unsigned int page_size;         /* FLASH page size in bytes */
+    unsigned int capabilities;      /* Programmer extensions beyond AVR109 */
+    unsigned int lock_fuse;         /* Lock and fuse bytes that can be read,
+                                       and in the upper four bits written */
+} avrprog_info;
+
+/* Lock and fuse bytes */
+typedef struct
+{
+    unsigned char lock;
+    unsigned char low;
+    unsigned char high;
+    unsigned char extended;
+} avrprog_fuses;
+
+AVRPROG_EXPORT int avrprog_version(void);
+AVRPROG_EXPORT int avrprog_open(const char* port, unsigned int baudrate,
+                                unsigned int options, avrprog** handle);
+AVRPROG_EXPORT int avrprog_identify(avrprog* handle, avrprog_info* info);
+AVRPROG_EXPORT int avrprog_erase(avrprog* handle);
+AVRPROG_EXPORT int avrprog_program(avrprog* handle, unsigned int address,
+                                   const unsigned char* data,
+                                   unsigned int length, unsigned int options);
+AVRPROG_EXPORT int avrprog_verify(avrprog* handle, unsigned int address,
+                                  const unsigned char* data,
+                                  unsigned int length);
+AVRPROG_EXPORT int avrprog_read(avrprog* handle, unsigned int address,
+                                unsigned char* data, unsigned int length);
+AVRPROG_EXPORT int avrprog_read_fuses(avrprog* handle, avrprog_fuses* fuses);
+AVRPROG_EXPORT int avrprog_write_fuses(avrprog* handle,
+                                       const avrprog_fuses* fuses,
+                                       unsigned int select);
+AVRPROG_EXPORT int avrprog_run(avrprog* handle);
+AVRPROG_EXPORT const char* avrprog_error(avrprog* handle);
+AVRPROG_EXPORT void avrprog_close(avrprog* handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,613 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. C interface
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <QCoreApplication>
+#include <QString>
+#include <QByteArray>
+#include <QBuffer>
+#include <QDebug>
+#include <cstring>
+#include "avrprogrammer.h"
+#include "avrprog.h"
+
+// Baud rates that can be asked for, in the order of the engine's baud indices
+#define NUMBAUDS 8
+const unsigned int libraryBauds[NUMBAUDS] =
+                        {1200,2400,4800,9600,19200,38400,57600,115200};
+
+// The application object made if the calling program doesn't have one
+static int applicationArgc = 1;
+static char applicationName[] = "avrprog";
+static char* applicationArgv[] = {applicationName,0};
+
+// Why the last open failed, as there is no handle to keep it in
+static QByteArray openErrorText;
+
+//-----------------------------------------------------------------------------
+/** @brief The programming engine as seen from the C interface.
+
+Operations work on buffers rather than files, and report their results with
+the AVRPROG_ codes. The metrics are cleared at the start of each operation so
+that they don't grow over a long session.
+*/
+
+class LibraryProgrammer : public AvrProgrammer
+{
+public:
+    LibraryProgrammer(QString* p, uint initialBaudrate, bool debug);
+    void identify(avrprog_info* info);
+    int erase();
+    int program(const uint address, const uchar* data, const uint length,
+                const bool upload, const bool verify, const bool force);
+    int read(uint address, uchar* data, uint length);
+    int readFuses(avrprog_fuses* fuses);
+    int writeFuses(const avrprog_fuses* fuses, const uint select);
+    int run();
+private:
+    void updateProgress(int progress);
+    bool checkBuffer(const uint address, const uint length);
+    bool writeFuse(const char command, const uchar value);
+};
+
+/** @brief Open connection to a programmer */
+struct avrprog
+{
+    LibraryProgrammer* programmer;
+    QByteArray errorText;           //!< Last error, kept for avrprog_error()
+};
+
+//-----------------------------------------------------------------------------
+/** Constructor
+
+@param[in] p Serial port name.
+@param[in] initialBaudrate Index of the baud rate to start searching at.
+@param[in] debug Print debug messages.
+*/
+
+LibraryProgrammer::LibraryProgrammer(QString* p, uint initialBaudrate,
+                                     bool debug)
+                 : AvrProgrammer(p,initialBaudrate,debug)
+{
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Progress isn't shown, the caller has no display. */
+
+void LibraryProgrammer::updateProgress(int progress)
+{
+    Q_UNUSED(progress);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Describe the programmer and device found when opened
+
+@param[out] info Details.
+*/
+
+void LibraryProgrammer::identify(avrprog_info* info)
+{
+    memset(info,0,sizeof(avrprog_info));
+    for (uint n = 0; n < 3; n++) info->signature[n] = signatureArray[2-n];
+    strncpy(info->device,deviceType.toLatin1().constData(),
+            sizeof(info->device)-1);
+    strncpy(info->programmer,identifier.toLatin1().constData(),
+            sizeof(info->programmer)-1);
+    info->baudrate = syncBaudrate;
+    info->flash_size = flashSize;
+    info->eeprom_size = eepromSize;
+    info->page_size = pageSize;
+    info->capabilities = capabilities;
+    info->lock_fuse = lockFuse;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Erase the FLASH memory
+
+@returns AVRPROG_OK or the failure.
+*/
+
+int LibraryProgrammer::erase()
+{
+    char inBuffer[32];
+    runMetrics->clear();
+    if (! checkProgrammingMode())
+    {
+        errorMessage = "Programming Mode Failed";
+        return AVRPROG_ERR_LINK;
+    }
+    int phase = runMetrics->startPhase("Erase");
+    port->putChar('e');                 // erase all application memory
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <e>";
+    int numBytes = 0;
+    for (uint wait = 0; (numBytes == 0) && (wait < ERASE_WAITS); wait++)
+        numBytes = checkCommand(1);     // Give it more time - it may be long
+    bool sentOK = readPort(inBuffer,numBytes);
+    runMetrics->endPhase(phase);
+    if (! sentOK)
+    {
+        errorMessage = "Erase Fail";
+        return AVRPROG_ERR_LINK;
+    }
+    return AVRPROG_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Program or verify a buffer
+
+The buffer is given to the engine as an Intel hex image, so that it is written
+and checked in the same way as a file.
+
+@param[in] address Address of the first byte.
+@param[in] data Bytes to write or check.
+@param[in] length Number of bytes.
+@param[in] upload Erase and write the memory.
+@param[in] verify Check the memory against the buffer.
+@param[in] force Write even if the target already holds the data.
+@returns AVRPROG_OK or the failure.
+*/
+
+int LibraryProgrammer::program(const uint address, const uchar* data,
+                               const uint length, const bool upload,
+                               const bool verify, const bool force)
+{
+    if (! checkBuffer(address,length)) return AVRPROG_ERR_ARGUMENT;
+    QByteArray image;
+    for (uint start = 0; start < length; start += 16)
+    {
+        uint lineLength = 16;
+        if (lineLength > length - start) lineLength = length - start;
+        uint lineAddress = address + start;
+        uint checksum = lineLength + (lineAddress >> 8) + lineAddress;
+        QString line = QString(":%1%200").arg(lineLength,2,16,QChar('0'))
+                                 .arg(lineAddress,4,16,QChar('0'));
+        for (uint n = 0; n < lineLength; n++)
+        {
+            line += QString("%1").arg(data[start+n],2,16,QChar('0'));
+            checksum += data[start+n];
+        }
+        line += QString("%1").arg((0x100 - (checksum & 0xFF)) & 0xFF,2,16,QChar('0'));
+        image += line.toLatin1();
+        image += "\r\n";
+    }
+    image += ":00000001FF\r\n";
+    QBuffer buffer(&image);
+    buffer.open(QIODevice::ReadOnly);
+    skipIdentical = ! force;
+    runMetrics->clear();
+    loadHexCore(upload,verify,&errorMessage,&buffer,'F');
+    if (runOutcome == RUN_VERIFY) return AVRPROG_ERR_VERIFY;
+    if (runOutcome != RUN_OK) return AVRPROG_ERR_LINK;
+    return AVRPROG_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read the memory into a buffer
+
+@param[in] address Address of the first byte.
+@param[out] data Buffer for the bytes read.
+@param[in] length Number of bytes.
+@returns AVRPROG_OK or the failure.
+*/
+
+int LibraryProgrammer::read(uint address, uchar* data, uint length)
+{
+    if (! checkBuffer(address,length)) return AVRPROG_ERR_ARGUMENT;
+    runMetrics->clear();
+    int phase = runMetrics->startPhase("Read");
+    bool ok = checkProgrammingMode();
+    if (! ok) errorMessage = "Programming Mode Failed";
+    bool streaming = getReadBlockMode();
+    if (ok && streaming && (! startStreamRead(address,length,'F')))
+    {
+        ok = false;
+        errorMessage = "Device Read Failure";
+    }
+// Read in 256 byte blocks as readHexCore does
+    while (ok && (length > 0))
+    {
+        uint blockLength = 256;
+        if (blockLength > length) blockLength = length;
+        if (streaming) ok = readStream(data,blockLength);
+        else ok = readPage(data,blockLength,address,'F');
+        if (! ok) errorMessage = "Device Read Failure";
+        data += blockLength;
+        address += blockLength;
+        length -= blockLength;
+    }
+    runMetrics->endPhase(phase);
+    runOutcome = (ok ? RUN_OK : RUN_LINK);
+    return (ok ? AVRPROG_OK : AVRPROG_ERR_LINK);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read the lock and fuse bytes
+
+Those the device doesn't have are given as zero.
+
+@param[out] fuses Lock and fuse bytes.
+@returns AVRPROG_OK or the failure.
+*/
+
+int LibraryProgrammer::readFuses(avrprog_fuses* fuses)
+{
+    if ((lockFuse & 0x0F) == 0)
+    {
+        errorMessage = "The device's lock and fuse bytes can't be read";
+        return AVRPROG_ERR_UNSUPPORTED;
+    }
+    runMetrics->clear();
+    if (! checkProgrammingMode() ||
+        ! getLockFuse(lockFuse,lockBits,fuseBits,highFuseBits,extFuseBits))
+    {
+        errorMessage = "Lock and Fuse Read Failure";
+        return AVRPROG_ERR_LINK;
+    }
+    fuses->lock = lockBits;
+    fuses->low = fuseBits;
+    fuses->high = highFuseBits;
+    fuses->extended = extFuseBits;
+    return AVRPROG_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Write the selected lock and fuse bytes
+
+Nothing is written if any of the selected bytes can't be written to this
+device. The programmer reads the fuses on entry to programming mode, so that is
+entered again afterwards, as the lock and fuse dialogs do.
+
+@param[in] fuses Lock and fuse bytes.
+@param[in] select AVRPROG_LOCK and AVRPROG_FUSE_ bits of those to write.
+@returns AVRPROG_OK or the failure.
+*/
+
+int LibraryProgrammer::writeFuses(const avrprog_fuses* fuses, const uint select)
+{
+    if ((select & 0x0F) != select)
+    {
+        errorMessage = "Unknown lock or fuse byte selected";
+        return AVRPROG_ERR_ARGUMENT;
+    }
+    if ((select & (lockFuse >> 4)) != select)
+    {
+        errorMessage = "The selected bytes can't be written to this device";
+        return AVRPROG_ERR_UNSUPPORTED;
+    }
+    runMetrics->clear();
+    bool sentOK = checkProgrammingMode();
+    if (sentOK && (select & AVRPROG_LOCK)) sentOK = writeFuse('l',fuses->lock);
+    if (sentOK && (select & AVRPROG_FUSE_LOW)) sentOK = writeFuse('f',fuses->low);
+    if (sentOK && (select & AVRPROG_FUSE_HIGH)) sentOK = writeFuse('n',fuses->high);
+    if (sentOK && (select & AVRPROG_FUSE_EXTENDED))
+        sentOK = writeFuse('q',fuses->extended);
+    if (sentOK && (capabilities & CAP_FASTENTRY)) sentOK = setProgrammingMode(true);
+    if (! sentOK)
+    {
+        errorMessage = "Lock and Fuse Write Failure";
+        return AVRPROG_ERR_LINK;
+    }
+    return AVRPROG_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Reset the target and let it run
+
+The connection stays open, and programming mode is entered again by the next
+operation.
+
+@returns AVRPROG_OK or the failure.
+*/
+
+int LibraryProgrammer::run()
+{
+    if (! canRunTarget())
+    {
+        errorMessage = "The programmer can't run the target";
+        return AVRPROG_ERR_UNSUPPORTED;
+    }
+    if (! resetTarget()) return AVRPROG_ERR_LINK;
+    return AVRPROG_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Check that a buffer lies within the FLASH
+
+@returns true if it does.
+*/
+
+bool LibraryProgrammer::checkBuffer(const uint address, const uint length)
+{
+    if (length == 0)
+    {
+        errorMessage = "Nothing to transfer";
+        return false;
+    }
+    uint endAddress = address + length - 1;
+    if ((endAddress < address) || (endAddress > 0xFFFF))
+    {
+        errorMessage = "Only addresses below 64K are supported";
+        return false;
+    }
+    return checkRange(address,endAddress,&errorMessage,'F');
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Write a lock or fuse byte
+
+@param[in] command Write command for the byte.
+@param[in] value Byte to write.
+@returns true if the programmer accepted it.
+*/
+
+bool LibraryProgrammer::writeFuse(const char command, const uchar value)
+{
+    char inBuffer[32];
+    port->putChar(command);
+    port->putChar(value);
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <" << command << ">" << value;
+    int numBytes = checkCommand(1);
+    return readPort(inBuffer,numBytes);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Version of the interface
+
+@returns AVRPROG_API_VERSION of the library, which may be newer than that the
+caller was built with.
+*/
+
+int avrprog_version(void)
+{
+    return AVRPROG_API_VERSION;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Open a programmer
+
+The programmer is synchronized and the device identified. If this fails no
+handle is given back, and avrprog_error() with a null handle describes why.
+
+@param[in] port Serial port name, such as ttyUSB0 or /dev/pts/5.
+@param[in] baudrate Baud rate to start searching at, 0 for 38400.
+@param[in] options AVRPROG_DEBUG and AVRPROG_WORDMODE bits.
+@param[out] handle Connection to the programmer.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_open(const char* port, unsigned int baudrate, unsigned int options,
+                 avrprog** handle)
+{
+    if (handle == 0) return AVRPROG_ERR_ARGUMENT;
+    *handle = 0;
+    if (port == 0) return AVRPROG_ERR_ARGUMENT;
+    uint initialBaudrate = 5;
+    if (baudrate > 0)
+    {
+        for (initialBaudrate = 0; initialBaudrate < NUMBAUDS; initialBaudrate++)
+            if (libraryBauds[initialBaudrate] == baudrate) break;
+        if (initialBaudrate >= NUMBAUDS) return AVRPROG_ERR_ARGUMENT;
+    }
+// The serial port needs an event loop to be processed, so make one if needed
+    if (QCoreApplication::instance() == 0)
+        new QCoreApplication(applicationArgc,applicationArgv);
+    QString portName = QString::fromLocal8Bit(port);
+    LibraryProgrammer* programmer = new LibraryProgrammer(&portName,initialBaudrate,
+                                                          options & AVRPROG_DEBUG);
+    if (! programmer->success())
+    {
+        openErrorText = programmer->error().toLocal8Bit();
+        delete programmer;
+        return AVRPROG_ERR_NOPROGRAMMER;
+    }
+    openErrorText.clear();
+    if (options & AVRPROG_WORDMODE)
+    {
+        programmer->setParameter(READBLOCKMODE,false);
+        programmer->setParameter(WRITEBLOCKMODE,false);
+    }
+    *handle = new avrprog;
+    (*handle)->programmer = programmer;
+    return AVRPROG_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Describe the programmer and device
+
+@param[in] handle Open programmer.
+@param[out] info Details found when it was opened.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_identify(avrprog* handle, avrprog_info* info)
+{
+    if ((handle == 0) || (info == 0)) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    handle->programmer->identify(info);
+    return AVRPROG_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Erase the FLASH memory
+
+Programming erases the memory itself, so this is only needed to leave it blank.
+
+@param[in] handle Open programmer.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_erase(avrprog* handle)
+{
+    if (handle == 0) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    return handle->programmer->erase();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Program the FLASH memory from a buffer
+
+The memory is erased first. If the programmer can checksum the memory and it
+already holds the data, nothing is done unless AVRPROG_FORCE is given.
+
+@param[in] handle Open programmer.
+@param[in] address Address of the first byte.
+@param[in] data Bytes to write.
+@param[in] length Number of bytes.
+@param[in] options AVRPROG_VERIFY and AVRPROG_FORCE bits.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_program(avrprog* handle, unsigned int address,
+                    const unsigned char* data, unsigned int length,
+                    unsigned int options)
+{
+    if ((handle == 0) || (data == 0)) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    return handle->programmer->program(address,data,length,true,
+                                       options & AVRPROG_VERIFY,
+                                       options & AVRPROG_FORCE);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Check the FLASH memory against a buffer
+
+@param[in] handle Open programmer.
+@param[in] address Address of the first byte.
+@param[in] data Bytes the memory should hold.
+@param[in] length Number of bytes.
+@returns AVRPROG_OK, AVRPROG_ERR_VERIFY if they differ, or the failure.
+*/
+
+int avrprog_verify(avrprog* handle, unsigned int address,
+                   const unsigned char* data, unsigned int length)
+{
+    if ((handle == 0) || (data == 0)) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    return handle->programmer->program(address,data,length,false,true,true);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read the FLASH memory into a buffer
+
+@param[in] handle Open programmer.
+@param[in] address Address of the first byte.
+@param[out] data Buffer of at least length bytes.
+@param[in] length Number of bytes.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_read(avrprog* handle, unsigned int address, unsigned char* data,
+                 unsigned int length)
+{
+    if ((handle == 0) || (data == 0)) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    return handle->programmer->read(address,data,length);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read the lock and fuse bytes
+
+@param[in] handle Open programmer.
+@param[out] fuses Lock and fuse bytes, zero for those the device doesn't have.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_read_fuses(avrprog* handle, avrprog_fuses* fuses)
+{
+    if ((handle == 0) || (fuses == 0)) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    return handle->programmer->readFuses(fuses);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Write lock and fuse bytes
+
+Take care, as wrong fuses can leave the device unable to be programmed.
+
+@param[in] handle Open programmer.
+@param[in] fuses Lock and fuse bytes.
+@param[in] select AVRPROG_LOCK and AVRPROG_FUSE_ bits of those to write.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_write_fuses(avrprog* handle, const avrprog_fuses* fuses,
+                        unsigned int select)
+{
+    if ((handle == 0) || (fuses == 0)) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    return handle->programmer->writeFuses(fuses,select);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Reset the target and let it run, keeping the connection
+
+@param[in] handle Open programmer.
+@returns AVRPROG_OK or the failure.
+*/
+
+int avrprog_run(avrprog* handle)
+{
+    if (handle == 0) return AVRPROG_ERR_ARGUMENT;
+    if (! handle->programmer->success()) return AVRPROG_ERR_NOPROGRAMMER;
+    return handle->programmer->run();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Description of the last failure
+
+A null handle gives the reason the last open failed.
+
+@param[in] handle Programmer, which may be null.
+@returns the text, valid until the next call with this handle.
+*/
+
+const char* avrprog_error(avrprog* handle)
+{
+    if (handle == 0)
+    {
+        if (openErrorText.isEmpty()) return "No programmer handle";
+        return openErrorText.constData();
+    }
+    handle->errorText = handle->programmer->error().toLocal8Bit();
+    return handle->errorText.constData();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Leave programming mode and close the programmer
+
+The programmer is sent 'E', which starts the target application from a
+bootloader or passes the serial link through to it from a programmer.
+
+@param[in] handle Programmer, which may be null.
+*/
+
+void avrprog_close(avrprog* handle)
+{
+    if (handle == 0) return;
+    if (handle->programmer->success()) handle->programmer->quitProgrammer();
+    delete handle->programmer;
+    delete handle;
+}
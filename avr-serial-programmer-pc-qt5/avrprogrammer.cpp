@@ -0,0 +1,2657 @@
+/**
+@brief        Atmel Microcontroller Serial Port FLASH loader
+
+@detail Communicate with a serial port programmer, either AVR109 bootloader or
+other stand-alone programmer using the AVRProg protocol.
+
+This application connects to the programmer to identify it and collect various
+important information about the device being programmed. It then allows a hex
+file to be opened and transmitted for programming, using block or single
+mode, and with or without verification.
+
+17/2/2010 Removed test for end of Flash memory (as it was set for an 8K device)
+          Corrected the blocksize conversion from uchar to uint in 'b'
+6/9/2010  In syncProgrammer, calls to port->bytesAvailable() returned a (signed)
+          qint64, but this was assigned to a uint numBytes. Sometimes a -1 was
+          returned resulting in failure to sync. Added int checkBytes for the
+          tests and assigned this to numBytes when needed. Problem showed up
+          after Ubuntu upgrade.
+11/2/2016 Upgrade to QT5 and removal of qextserialport in favour of QT5 QSerial.
+
+The programming engine is kept free of the GUI, so that it can be built into a
+library and used by the command line program without a display. The dialog in
+avrserialprog.cpp is built on it.
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+// Specify an intercharacter timeout when receiving incoming communications
+#define TIMEOUTCOUNT 50
+// Time to wait for the response to a command (ms)
+#define COMMAND_TIMEOUT 300
+
+#include <QCoreApplication>
+#include <QString>
+#include <QByteArray>
+#include <QFileInfo>
+#include <QSerialPort>
+#include <QSerialPortInfo>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <iostream>
+#include "avrprogrammer.h"
+#include "metricsfile.h"
+
+#define IDLE_CHAR 0xDD
+#define SYNC_CHAR 0x67
+#define EOM_CHAR 0x03
+// Number of consecutive ESC characters that end the programmer's passthrough
+#define ESCAPE_COUNT 16
+// Response to a damaged CRC framed block, and attempts before giving up
+#define NAK_CHAR 0x15
+#define FRAME_RETRIES 5
+// Enough ESC characters to complete any frame the programmer is still receiving
+#define FRAME_FLUSH 132
+// Introduces a run of identical bytes in run length encoded blocks
+#define RLE_MARKER 0xA5
+// Largest block asked for at a time in a streaming read (the largest FLASH)
+#define STREAM_BLOCK 0x8000
+
+//-----------------------------------------------------------------------------
+/* Supported devices arrays.
+Type is a single digit indicator of the lock/fuse byte structure.
+EPage is the number of bytes in an EEPROM page.
+Busy is a boolean indicator that a busy status command is provided.
+Flash and EEPROM are the memory sizes in bytes.
+FPage is the number of words in a FLASH page (zero if not paged).
+Lock and Fuse support is given by a bitwise quantity.
+0 = Lock Read
+1 = Fuse Read
+2 = High Fuse Read
+3 = Extended Fuse Read
+4 = Lock Write
+5 = Fuse Write
+6 = High Fuse Write
+7 = Extended Fuse Write
+*/
+
+#define NUMPARTS 19
+const uint part[NUMPARTS][9] = {
+/* Sig 2, Sig 3,   Type, EPage, Busy, Lock/Fuse, Flash, EEPROM, FPage */
+{   0x91,  0x01,   12313, 0,   false,  0x10,   2048,   128,   0  },  // AT90S2313
+{   0x91,  0x0B,   261,   4,   true,   0xFF,   2048,   128,  16  },  // ATTiny24
+{   0x91,  0x09,   26,    0,   false,  0x77,   2048,   128,  16  },  // ATTiny26
+{   0x91,  0x0A,   2313,  4,   true,   0xFF,   2048,   128,  16  },  // ATTiny2313
+{   0x91,  0x0C,   261,   4,   true,   0xFF,   2048,   128,  16  },  // ATTiny261
+{   0x92,  0x0D,   2313,  4,   true,   0xFF,   4096,   256,  32  },  // ATTiny4313
+{   0x92,  0x07,   261,   4,   true,   0xFF,   4096,   256,  32  },  // ATTiny44
+{   0x92,  0x05,   48,    4,   true,   0xFF,   4096,   256,  32  },  // ATMega48
+{   0x92,  0x08,   261,   4,   true,   0xFF,   4096,   256,  32  },  // ATTiny461
+{   0x92,  0x15,   441,   4,   true,   0xFF,   4096,   256,   8  },  // ATTiny441
+{   0x93,  0x0C,   261,   4,   true,   0xFF,   8192,   512,  32  },  // ATTiny84
+{   0x93,  0x08,   8535,  0,   false,  0x77,   8192,   512,  32  },  // ATMega8535
+{   0x93,  0x0A,   88,    4,   true,   0xFF,   8192,   512,  32  },  // ATMega88
+{   0x93,  0x0D,   261,   4,   true,   0xFF,   8192,   512,  32  },  // ATTiny861
+{   0x93,  0x15,   441,   4,   true,   0xFF,   8192,   512,   8  },  // ATTiny841
+{   0x94,  0x03,   16,    4,   true,   0x77,  16384,   512,  64  },  // ATMega16
+{   0x94,  0x06,   88,    4,   true,   0xFF,  16384,   512,  64  },  // ATMega168
+{   0x95,  0x0F,   328,   4,   true,   0xFF,  32768,  1024,  64  },  // ATMega328
+{   0x95,  0x02,   16,    0,   false,  0x77,  32768,  1024,  64  }   // ATMega32
+};
+const QString partName[NUMPARTS] = {
+"AT90S2313",
+"ATTiny24",
+"ATTiny26",
+"ATTiny2313",
+"ATTiny261",
+"ATTiny4313",
+"ATTiny44",
+"ATMega48",
+"ATTiny461",
+"ATTiny441",
+"ATTiny84",
+"ATMega8535",
+"ATMega88",
+"ATTiny861",
+"ATTiny841",
+"ATMega16",
+"ATMega168",
+"ATMega328",
+"ATMega32"
+};
+
+const qint32 bauds[8] = {1200,2400,4800,9600,19200,38400,57600,115200};
+
+// Names of the outcomes of a run, in the order of the outcome enumeration
+const char* outcomeNames[] = {"ok","usage_error","no_programmer",
+                              "file_error","link_error","verify_failed"};
+//-----------------------------------------------------------------------------
+/** Constructor
+
+To build the object, the serial connection to the device is synchronized, the
+device is interrogated for details, and inforamtion about lock and fuse bits is
+retrieved.
+
+@param[in] p Serial Port object pointer
+@param[in] uint initialBaudrate: index to baudrate array
+@param[in] bool debug: print debug messages
+@param[in] traceFile File to save a trace of the serial traffic in, if given.
+*/
+
+AvrProgrammer::AvrProgrammer(QString* p, uint initialBaudrate,bool debug,
+                             const QString traceFile)
+{
+    port = new TracedSerialPort(*p);
+    trace = 0;
+    traceFileName = traceFile;
+    if (! traceFileName.isEmpty())
+    {
+        trace = new SerialTrace();
+        port->setTrace(trace);
+    }
+    runMetrics = new ProgrammerMetrics(port);
+    debugMode = debug;
+    if (debugMode) qDebug() << "Debug Mode";
+    verify = true;
+    upload = true;
+    passThrough = true;
+    runTarget = false;
+    onboardVerify = false;
+    skipIdentical = false;
+    unchanged = false;
+    capabilities = 0;
+    roundTrips = 0;
+    runOutcome = RUN_OK;
+    imageBytes = 0;
+    metricsReplace = false;
+    syncBaudrate = 0;
+// Nothing is known of the programmer or device until the query gets it
+    synchronized = false;
+    programmingMode = false;
+    autoincrement = false;
+    blockSupport = false;
+    pageSize = 0;
+    flashSize = 0;
+    eepromSize = 0;
+    flashPageSize = 0;
+    streamWanted = 0;
+    streamUnrequested = 0;
+    streamPending = 0;
+// Query the programmer and get device and programmer parameters
+    int phase = runMetrics->startPhase("Initialize");
+    queried = initializeProgrammer(initialBaudrate);
+    runMetrics->endPhase(phase);
+    readBlockMode = blockSupport;
+    writeBlockMode = blockSupport;
+    autoincrementMode = autoincrement;
+}
+
+AvrProgrammer::~AvrProgrammer()
+{
+    port->close();
+    if (trace)
+    {
+        port->setTrace(0);
+        if (! trace->save(traceFileName))
+            qDebug() << "Could not write trace file" << traceFileName;
+        delete trace;
+    }
+    delete runMetrics;
+    delete port;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Successful synchronization
+
+@returns true if the device responded eventually with a verified bootloader
+response, and all the programmer and device details were obtained.
+*/
+bool AvrProgrammer::success()
+{
+    return (synchronized && queried);
+}
+//-----------------------------------------------------------------------------
+/** @brief Error Message
+
+@returns a message when the device didn't respond properly.
+*/
+QString AvrProgrammer::error()
+{
+    return errorMessage;
+}
+//-----------------------------------------------------------------------------
+/** @brief Round trip count
+
+@returns the number of times a response has been waited for since the object
+was created. Used to measure how chatty the transfer methods are.
+*/
+uint AvrProgrammer::roundTripCount()
+{
+    return roundTrips;
+}
+//-----------------------------------------------------------------------------
+/** @brief Target run capability
+
+@returns true if the programmer can reset and run the target with 'X'.
+*/
+bool AvrProgrammer::canRunTarget()
+{
+    return ((capabilities & CAP_RUN) != 0);
+}
+//-----------------------------------------------------------------------------
+/** @brief Run metrics
+
+@returns the phase times, traffic, retries and command latencies of the last
+run, or of the initialization if nothing has been run yet.
+*/
+const ProgrammerMetrics& AvrProgrammer::metrics()
+{
+    return *runMetrics;
+}
+//-----------------------------------------------------------------------------
+
+/** @defgroup This section comprises the methods a user interface may replace.
+
+@{*/
+//-----------------------------------------------------------------------------
+/** @brief Show the progress of a transfer.
+
+On the command line this extends a bar of '=' characters.
+*/
+
+void AvrProgrammer::updateProgress(int progress)
+{
+    Q_UNUSED(progress);
+    if (! debugMode) std::cerr << "=";
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Get the read block mode setting.
+
+*/
+
+bool AvrProgrammer::getReadBlockMode()
+{
+    return readBlockMode;
+}
+//-----------------------------------------------------------------------------
+/** @brief Get the write block mode setting.
+
+*/
+
+bool AvrProgrammer::getWriteBlockMode()
+{
+    return writeBlockMode;
+}
+/**@}*/
+//-----------------------------------------------------------------------------
+
+/** @defgroup This section comprises Command Line Only methods.
+
+@{*/
+//-----------------------------------------------------------------------------
+/** @brief Print out all device and programmer details.
+
+This is intended for the non-GUI command line operation only.
+
+*/
+
+void AvrProgrammer::printDetails(void)
+{
+    qDebug() << "========= Detected Details ============";
+    qDebug() << "Programmer " << identifier;
+    qDebug() << QString("Capabilities %1").arg(capabilities,4,16,QLatin1Char('0'));
+    qDebug() << QString("Lock Byte %1").arg(lockBits,2,16);
+    qDebug() << QString("Fuse Byte %1").arg(fuseBits,2,16);
+    qDebug() << QString("High Fuse Byte %1").arg(highFuseBits,2,16);
+    qDebug() << QString("Extended Fuse Byte %1").arg(extFuseBits,2,16);
+    qDebug() << QString("Signature %1 %2 %3")
+                       .arg((uchar)signatureArray[2],2,16,QLatin1Char('0'))
+                       .arg((uchar)signatureArray[1],2,16,QLatin1Char('0'))
+                       .arg((uchar)signatureArray[0],2,16,QLatin1Char('0'));
+    qDebug() << "Device Detected " << deviceType;
+    if (flashSize > 0)
+        qDebug() << QString("FLASH %1 bytes, EEPROM %2 bytes, Page %3 words")
+                       .arg(flashSize).arg(eepromSize).arg(flashPageSize);
+}
+//-----------------------------------------------------------------------------
+/** @brief Print out the run metrics.
+
+This is intended for the non-GUI command line operation only.
+
+*/
+
+void AvrProgrammer::printMetrics(void)
+{
+    qDebug() << "========= Run Metrics =================";
+    QStringList lines = runMetrics->report().split('\n');
+    for (int n = 0; n < lines.size(); n++)
+        if (! lines[n].isEmpty()) qDebug() << qPrintable(lines[n]);
+}
+//-----------------------------------------------------------------------------
+/** @brief Outcome of the last command line run.
+
+@returns RUN_NOPROGRAMMER if the programmer was never contacted or didn't give
+all its details, otherwise the outcome of the last upload or download, RUN_OK if
+there was none.
+*/
+
+outcome AvrProgrammer::result()
+{
+    if (! success()) return RUN_NOPROGRAMMER;
+    return runOutcome;
+}
+//-----------------------------------------------------------------------------
+/** @brief Record a run that was refused before anything was done.
+
+The outcome is then RUN_USAGE, and the message is given in the JSON report.
+
+@param[in] message Why the run was refused.
+*/
+
+void AvrProgrammer::refuseRun(const QString message)
+{
+    errorMessage = message;
+    runOutcome = RUN_USAGE;
+}
+//-----------------------------------------------------------------------------
+/** @brief Describe the device and the last run in JSON.
+
+This is intended for the non-GUI command line operation only, so that test
+fixtures can read the outcome without parsing the log. Times are in seconds
+except for the command latencies, which are in milliseconds. The throughput is
+the image size over the time of the phases after initialization.
+
+@param[in] filename File that was uploaded or downloaded, if any.
+@returns the JSON document.
+*/
+
+QByteArray AvrProgrammer::jsonReport(const QString filename)
+{
+    QJsonObject report;
+    outcome runResult = result();
+    report["result"] = resultName();
+    report["exit_code"] = (int)runResult;
+    if (runResult != RUN_OK) report["error"] = errorMessage;
+    QJsonObject programmer;
+    programmer["identifier"] = identifier;
+    programmer["capabilities"] = (int)capabilities;
+    report["programmer"] = programmer;
+    if (synchronized)
+    {
+        QJsonObject device;
+        device["type"] = deviceType;
+        device["signature"] = QString("%1%2%3")
+                       .arg((uchar)signatureArray[2],2,16,QLatin1Char('0'))
+                       .arg((uchar)signatureArray[1],2,16,QLatin1Char('0'))
+                       .arg((uchar)signatureArray[0],2,16,QLatin1Char('0'));
+        device["flash_bytes"] = (int)flashSize;
+        device["eeprom_bytes"] = (int)eepromSize;
+        device["page_words"] = (int)flashPageSize;
+        report["device"] = device;
+        QJsonObject fuses;
+        if (lockFuse & 0x01)
+            fuses["lock"] = QString("0x%1").arg(lockBits,2,16,QLatin1Char('0'));
+        if (lockFuse & 0x02)
+            fuses["low"] = QString("0x%1").arg(fuseBits,2,16,QLatin1Char('0'));
+        if (lockFuse & 0x04)
+            fuses["high"] = QString("0x%1").arg(highFuseBits,2,16,QLatin1Char('0'));
+        if (lockFuse & 0x08)
+            fuses["extended"] = QString("0x%1").arg(extFuseBits,2,16,QLatin1Char('0'));
+        report["fuses"] = fuses;
+    }
+// The hash is of the file as it is on disk, written or to be read
+    if (! filename.isEmpty())
+    {
+        QJsonObject image;
+        QFile file(filename);
+        if (! file.exists() && ! filename.endsWith(".hex"))
+            file.setFileName(filename + ".hex");
+        image["file"] = file.fileName();
+        image["bytes"] = (int)imageBytes;
+        if (file.open(QIODevice::ReadOnly))
+        {
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            while (! file.atEnd()) hash.addData(file.read(0x10000));
+            image["sha256"] = QString(hash.result().toHex());
+        }
+        report["image"] = image;
+    }
+    QJsonArray phases;
+    const QList<MetricsPhase>& phaseList = runMetrics->phases();
+    for (int n = 0; n < phaseList.size(); n++)
+    {
+        const MetricsPhase& entry = phaseList[n];
+        if (entry.duration < 0) continue;
+        QJsonObject phase;
+        phase["name"] = entry.name;
+        phase["depth"] = (int)entry.depth;
+        phase["seconds"] = entry.duration/1e9;
+        phase["bytes_sent"] = (double)entry.bytesSent;
+        phase["bytes_received"] = (double)entry.bytesReceived;
+        phase["round_trips"] = (int)entry.roundTrips;
+        phases.append(phase);
+    }
+    report["phases"] = phases;
+    double runTime = runSeconds();
+    report["seconds"] = runTime;
+    report["bytes_per_second"] = ((runTime > 0) ? imageBytes/runTime : 0.0);
+    QJsonObject link;
+    link["bytes_sent"] = (double)runMetrics->bytesSent();
+    link["bytes_received"] = (double)runMetrics->bytesReceived();
+    link["round_trips"] = (int)runMetrics->roundTrips();
+    link["timeouts"] = (int)runMetrics->timeouts();
+    link["retries"] = (int)runMetrics->retries();
+    link["resyncs"] = (int)runMetrics->resyncs();
+    link["verify_mismatches"] = (int)runMetrics->mismatches();
+    report["link"] = link;
+    QJsonObject latencies;
+    QList<char> commands = runMetrics->commands();
+    for (int n = 0; n < commands.size(); n++)
+    {
+        char command = commands[n];
+        QJsonObject latency;
+        latency["count"] = (int)runMetrics->responses(command);
+        latency["median"] = runMetrics->latency(command,50)/1e6;
+        latency["p90"] = runMetrics->latency(command,90)/1e6;
+        latency["p99"] = runMetrics->latency(command,99)/1e6;
+        latency["max"] = runMetrics->latency(command,100)/1e6;
+        QString name = ((command > ' ') && (command < 0x7F)) ? QString(command)
+                     : QString("%1").arg((uchar)command,2,16,QLatin1Char('0'));
+        latencies[name] = latency;
+    }
+    report["latency_ms"] = latencies;
+    return QJsonDocument(report).toJson();
+}
+//-----------------------------------------------------------------------------
+/** @brief Name of the outcome of the last run.
+
+@returns the outcome name, or "unchanged" if the target already held the image.
+*/
+
+QString AvrProgrammer::resultName()
+{
+    outcome runResult = result();
+    if ((runResult == RUN_OK) && unchanged) return "unchanged";
+    return outcomeNames[runResult];
+}
+//-----------------------------------------------------------------------------
+/** @brief Time taken by the last run.
+
+@returns the time in seconds of the phases of the run after initialization.
+*/
+
+double AvrProgrammer::runSeconds()
+{
+    double runTime = 0;
+    const QList<MetricsPhase>& phaseList = runMetrics->phases();
+    for (int n = 0; n < phaseList.size(); n++)
+    {
+        const MetricsPhase& entry = phaseList[n];
+        if ((entry.duration >= 0) && (entry.depth == 0) &&
+            (entry.name != "Initialize")) runTime += entry.duration/1e9;
+    }
+    return runTime;
+}
+//-----------------------------------------------------------------------------
+/** @brief Set a file to export the metrics of each session to.
+
+@param[in] fileName Prometheus text file, such as one in the directory of the
+           node exporter's textfile collector.
+@param[in] replace Start the counters afresh rather than adding to those in the
+           file.
+*/
+
+void AvrProgrammer::setMetricsFile(const QString fileName, const bool replace)
+{
+    metricsFileName = fileName;
+    metricsReplace = replace;
+}
+//-----------------------------------------------------------------------------
+/** @brief Export the metrics of the last session.
+
+The counters and histograms in the metrics file have this session added to
+them, and the gauges are set to show how it went. Nothing is done if no file
+has been set.
+
+@returns false if the metrics file could not be read or written.
+*/
+
+bool AvrProgrammer::exportMetrics()
+{
+    if (metricsFileName.isEmpty()) return true;
+    MetricsFile file(metricsFileName);
+    if (! metricsReplace && ! file.load())
+    {
+        qDebug() << "Could not read metrics file" << metricsFileName;
+        return false;
+    }
+    double duration = runMetrics->elapsed()/1e9;
+    double runTime = runSeconds();
+    file.describe("avrprog_sessions_total","counter","Programming sessions by result.");
+    file.add(QString("avrprog_sessions_total{result=\"%1\"}").arg(resultName()),1);
+    file.describe("avrprog_session_duration_seconds","histogram",
+                  "Time from contacting the programmer to the end of the session.");
+    file.observe("avrprog_session_duration_seconds",
+                 QList<double>() << 1 << 2 << 5 << 10 << 20 << 30 << 60 << 120 << 300,
+                 duration);
+    file.describe("avrprog_throughput_bytes_per_second","histogram",
+                  "Image bytes over the time taken to load or read them.");
+    if ((imageBytes > 0) && (runTime > 0))
+        file.observe("avrprog_throughput_bytes_per_second",
+                     QList<double>() << 100 << 200 << 500 << 1000 << 2000
+                                     << 5000 << 10000 << 20000,
+                     imageBytes/runTime);
+    file.describe("avrprog_verify_failures_total","counter",
+                  "Pages that failed verification, counting each attempt.");
+    file.add("avrprog_verify_failures_total",runMetrics->mismatches());
+    file.describe("avrprog_resyncs_total","counter","Resynchronizations of the programmer.");
+    file.add("avrprog_resyncs_total",runMetrics->resyncs());
+    file.describe("avrprog_retries_total","counter",
+                  "Pages, frames and addresses sent again after a failure.");
+    file.add("avrprog_retries_total",runMetrics->retries());
+    file.describe("avrprog_timeouts_total","counter","Waits for a response that timed out.");
+    file.add("avrprog_timeouts_total",runMetrics->timeouts());
+    file.describe("avrprog_bytes_sent_total","counter","Bytes sent to the programmer.");
+    file.add("avrprog_bytes_sent_total",runMetrics->bytesSent());
+    file.describe("avrprog_bytes_received_total","counter","Bytes received from the programmer.");
+    file.add("avrprog_bytes_received_total",runMetrics->bytesReceived());
+    file.describe("avrprog_syncs_total","counter",
+                  "Synchronizations with the programmer by the baud rate found.");
+    if (syncBaudrate > 0)
+        file.add(QString("avrprog_syncs_total{baud=\"%1\"}").arg(syncBaudrate),1);
+    file.describe("avrprog_sync_baud","gauge",
+                  "Baud rate found in the last session, 0 if there was no answer.");
+    file.set("avrprog_sync_baud",syncBaudrate);
+    file.describe("avrprog_last_session_success","gauge",
+                  "1 if the last session succeeded, otherwise 0.");
+    file.set("avrprog_last_session_success",(result() == RUN_OK) ? 1 : 0);
+    file.describe("avrprog_last_session_duration_seconds","gauge",
+                  "Duration of the last session.");
+    file.set("avrprog_last_session_duration_seconds",duration);
+    file.describe("avrprog_last_session_timestamp_seconds","gauge",
+                  "Time the last session ended, in seconds since the epoch.");
+    file.set("avrprog_last_session_timestamp_seconds",
+             QDateTime::currentMSecsSinceEpoch()/1000.0);
+    if (! file.save())
+    {
+        qDebug() << "Could not write metrics file" << metricsFileName;
+        return false;
+    }
+    return true;
+}
+//-----------------------------------------------------------------------------
+/** @brief Open an AVR Intel Hex program file and perform requested operations.
+
+Open file to upload and call a loader function. This is for the command line
+operation only.
+
+A .hex file indicates an Intel Hex file for Flash memory
+A .eep file indicates an intel hex file for EEPROM
+
+@todo Add in EEPROM access, which involves the write and read page routines
+issuing the different commands.
+*/
+
+bool AvrProgrammer::uploadHex(QString filename)
+{
+    bool error = true;
+    runOutcome = RUN_FILE;
+    qDebug() << "Uploading file " << filename;
+    if (! filename.isEmpty())
+    {
+        QFileInfo fileInfo(filename);
+        QFile file(filename);
+        uint numberProgressSteps = 0;
+        if ((pageSize>>4) > 0) numberProgressSteps = (file.size())/44/(pageSize>>4);
+        std::cerr << "|";
+        for (uint n=0; n<numberProgressSteps;n++) std::cerr << "-";
+        std::cerr << "|" << std::endl;
+        if (file.open(QIODevice::ReadOnly))
+        {
+            std::cerr << " ";
+            error = loadHexCore(upload, verify, &errorMessage, &file, 'F');
+            std::cerr << std::endl;
+        }
+        else errorMessage = "File open error";
+    }
+    else errorMessage = "Filename is blank";
+    if (error) qDebug() << errorMessage;
+    return error;
+}
+//-----------------------------------------------------------------------------
+/** @brief Read from the AVR in hex form to a file.
+
+Open file to download and call a loader function. This is for the command line
+operation only.
+
+A .hex file indicates an Intel Hex file for Flash memory
+A .eep file indicates an intel hex file for EEPROM
+
+@todo Add in EEPROM access, which involves the read page routines issuing the
+different commands.
+*/
+
+bool AvrProgrammer::downloadHex(QString filename, int startAddress, int endAddress)
+{
+    bool error = false;
+    runOutcome = RUN_FILE;
+    qDebug() << "Downloading file " << filename;
+    if (filename.isEmpty())
+    {
+        errorMessage = "Filename is blank";
+        qDebug() << errorMessage;
+        return true;
+    }
+    uint lastAddress = endAddress;
+    if (! checkRange(startAddress,lastAddress,&errorMessage,'F'))
+    {
+        qDebug() << errorMessage;
+        return true;
+    }
+    uint blockLength = lastAddress - startAddress + 1;
+    if (! filename.endsWith(".hex")) filename.append(".hex");
+    QFileInfo fileInfo(filename);
+    saveDirectory = fileInfo.absolutePath();
+    saveFile = saveDirectory.filePath(filename);
+    QFile outFile(saveFile);                // Open file for output
+    if (! outFile.open(QIODevice::WriteOnly))
+    {
+        error = true;
+        errorMessage = "Could not open the output file";
+    }
+    else
+    {
+        uint numberProgressSteps = 0;
+        if ((pageSize>>4) > 0) numberProgressSteps = (blockLength)/44/(pageSize>>4);
+        std::cerr << "|";
+        for (uint n=0; n<numberProgressSteps;n++) std::cerr << "-";
+        std::cerr << "|" << std::endl;
+        std::cerr << " ";
+        error = readHexCore(startAddress, blockLength, &errorMessage, &outFile, 'F');
+        std::cerr << std::endl;
+        outFile.close();
+    }
+    if (error) qDebug() << errorMessage;
+    return error;
+}
+//-----------------------------------------------------------------------------
+/** @brief Leave the Programming Mode.
+
+This is called from Main. Passthrough takes precedence over simply running the
+target.
+*/
+
+void AvrProgrammer::quitProgrammer()
+{
+    if (passThrough) sendCommand('E');                   // "E" takes us out of programming mode
+    else if (runTarget) resetTarget();
+}
+/**@}*/
+//-----------------------------------------------------------------------------
+
+/** @defgroup This section comprises all the GUI independent methods.
+
+@{*/
+//-----------------------------------------------------------------------------
+/** @brief Set control parameters.
+
+This sets a boolean control parameter to a boolean value.
+
+@param[in] parameter to be set, enum param type indicating the parameter.
+*/
+
+void AvrProgrammer::setParameter(param parameter, bool value)
+{
+    switch (parameter)
+    {
+    case VERIFY: verify = value;break;
+    case UPLOAD: upload = value;break;
+    case DEBUG: debugMode = value;break;
+    case READBLOCKMODE: readBlockMode = value;break;
+    case WRITEBLOCKMODE: writeBlockMode = value;break;
+    case AUTOINCREMENTMODE: autoincrementMode = value;break;
+    case PASSTHROUGH: passThrough = value;break;
+    case RUNTARGET: runTarget = value;break;
+    case ONBOARDVERIFY: onboardVerify = value;break;
+    case SKIPIDENTICAL: skipIdentical = value;break;
+    }
+}
+//-----------------------------------------------------------------------------
+/** @brief Load a .hex file to either Flash or EEPROM
+
+Block loads cause difficulties, as a block relates to a page of flash memory
+that is buffered on chip and then written. Therefore ensure that when a
+block is sent, it starts and ends on a single page boundary. This requires
+some gymnastics in regard to watching the address counter, identifying gaps, and
+ensuring that they are taken into account.
+
+Note also that the 16 bit words are stored MSB first in the buffer and in the
+target.
+
+@param[in] upload Boolean indicating if an upload is to be done.
+@param[in] verify Boolean indicating if a verification is to be done
+           (exclusively or after upload).
+@param[out] errorMessage Error message to print if any failure occurs.
+@param[in] file File or buffer already opened for loading.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM.
+           Passed to lower routines
+@returns boolean indicating if an error occurred.
+*/
+
+bool AvrProgrammer::loadHexCore(bool upload, bool verify, QString* errorMessage,
+                                QIODevice* file, const uchar memType)
+{
+    char inBuffer[256];                     // Buffer for serial read
+    bool sentOK = true;
+    bool verifyOK = true;
+    int progress=0;
+
+/** The image is measured for the throughput. A file that doesn't fit the
+device is rejected before anything is sent to the programmer. */
+    QMap<uint,QByteArray> image;
+    uint imageEnd = 0;
+    imageBytes = 0;
+    if ((pageSize > 0) && parseHexFile(file,image,&imageEnd))
+    {
+        imageBytes = image.size()*pageSize;
+        uint memorySize = deviceMemorySize(memType);
+        if (upload && (memorySize > 0) && (imageEnd > memorySize))
+        {
+            *errorMessage = QString("File is larger than the %1 %2").arg(deviceType)
+                                .arg((memType == 'E') ? "EEPROM" : "FLASH");
+            runOutcome = RUN_FILE;
+            return true;
+        }
+    }
+    file->seek(0);
+/** If the programmer can checksum the target memory, a target that already
+holds the image need not be erased and written again. Fuses aren't part of the
+hex file, so they are left as they are in any case. */
+    unchanged = false;
+    if (upload && skipIdentical && (memType == 'F') && (capabilities & CAP_CHECKSUM))
+    {
+        *errorMessage = "Checksum Failure";
+        int phase = runMetrics->startPhase("Compare");
+        sentOK = checkProgrammingMode();
+        if (sentOK) sentOK = compareImage(file,memType,unchanged);
+        runMetrics->endPhase(phase);
+        runOutcome = RUN_LINK;
+        if (! sentOK) return true;
+        runOutcome = RUN_OK;
+        if (unchanged)
+        {
+            qDebug() << "No change, the target already holds this image";
+            return false;
+        }
+        file->seek(0);
+    }
+    if (upload || verify)
+    {
+        *errorMessage = "Programming Mode Failed";
+        sentOK = checkProgrammingMode();
+        if (sentOK && upload)
+        {
+/** If a program operation is requested, erase the application memory and open
+the file stream (this will erase lock bits if not accessing a bootloader).*/
+            if (debugMode) qDebug() << "Start Chip Erase";
+            int phase = runMetrics->startPhase("Erase");
+            port->putChar('e');             // erase all application memory
+            qApp->processEvents();          // Allow send and receive to occur
+            int numBytes = 0;
+            for (uint wait = 0; (numBytes == 0) && (wait < ERASE_WAITS); wait++)
+                numBytes = checkCommand(1); // Give it more time - it may be long
+            *errorMessage = "Erase Fail";
+            sentOK = readPort(inBuffer,numBytes);
+            runMetrics->endPhase(phase);
+            if (debugMode) qDebug() << "Finish Chip Erase";
+        }
+//! If erased OK then open file and start loading up the block buffer
+      	if (sentOK)
+      	{
+      	    if (debugMode) qDebug() << "Start of Program Load";
+            QTextStream stream(file);
+            bool ok;
+            uint runningAddress=0;      	// AVR Flash next address
+            uint blockStartAddress=0;      	// AVR Flash start of block address
+//! Create a buffer for a block write (greater than pagesize)
+            uchar blockBuffer[256];       	// Holding for a block write
+            uint blockIndex = 0;          	// track the number in the buffer
+            QMap<uint,QByteArray> writtenPages;     // Pages waiting for verification
+//! On the first pass the running address needs to be determined.
+            bool firstPass = true;
+            int phase = runMetrics->startPhase(upload ? "Write" : "Verify");
+            while (! stream.atEnd() && sentOK && verifyOK)
+            {
+              	QString line = stream.readLine();
+/** Interpret the Intel Hex format line to get line length, record type and
+address.*/
+               	uint lineLength = line.mid(1,2).toUInt(&ok,16);
+               	uint address = (line.mid(3,4).toUInt(&ok,16));
+               	uint recordType = line.mid(7,2).toUInt(&ok,16);
+                progress += line.length();
+				if (debugMode)
+				{
+	                qDebug() << line;
+    	            qDebug() << "Line Length " << lineLength << "Start Address"
+                             << address << "Record" << recordType;
+				}
+                uint lineIndex = 0;	        // Index into line to be put in buffer
+/** On the first pass, the address of the first byte must be determined. This is
+only needed once for a block as the running address counter follows the address
+to be programmed. If the data does not start on a page boundary then the running
+address starts earlier and the buffer will be filled with dummy data.*/
+                if (firstPass)
+                {
+                    firstPass = false;
+                    runningAddress = address - address % pageSize;
+    		            blockStartAddress = runningAddress;
+                    *errorMessage = "Address Setting Failure";
+                    sentOK = sendAddress(runningAddress);
+				if (debugMode)
+				{
+                    qDebug() << "First Pass. runningAddress " << runningAddress << sentOK;
+				}
+                    if (! sentOK) break;
+                }
+                if (recordType != 0) lineLength = 1;    // fudge to get loop to go once at end
+	        	    while (lineIndex < lineLength)
+	        	    {
+/** If a terminating record (record type = 0x01) occurs, then do not process any
+more record data, but skip straight to the block upload of the remainder.*/
+              	    if (recordType == 0)      	// Normal record
+              	    {
+/** If the next address to be programmed is earlier than that in the file,
+then there is a gap in the byte stream. Fill the buffer with dummy data,
+otherwise fill the local block buffer with the program data.*/
+                       	if (runningAddress > address)
+		          	        {
+                            *errorMessage = "Address Tracking Error";
+			                      sentOK = false;	    // error condition so get out
+			                      break;
+		          	        }
+		          	        else if (runningAddress < address)
+                                  blockBuffer[blockIndex] = 0xFF;
+		          	        else
+		          	        {
+                            blockBuffer[blockIndex] =
+                            	line.mid((lineIndex<<1)+9,2).toUInt(&ok,16);
+			                      address++;	        // Follow runningAddress
+    		                    lineIndex++;
+      		    	        }
+						if (debugMode)
+						{
+	                        qDebug() << address << lineIndex << runningAddress
+                                     << blockIndex << line.mid(((lineIndex-1)<<1)+9,2)
+                                     << blockBuffer[blockIndex];
+						}
+                        ++runningAddress;       // track the address
+                        ++blockIndex;
+                    }
+    		            else
+  		    	        lineIndex = lineLength; // Terminate the loop
+/** When the block buffer has been filled, start a blockload command that
+transfers the block up to the device memory.*/
+                    if (((blockIndex >= pageSize) || (recordType != 0)) && (blockIndex > 0))
+                    {
+                        if (debugMode)
+                        {
+                            qDebug() << "Write/Verify Page at address"
+                                 << QString("%1 ").arg(blockStartAddress,2,16,QLatin1Char('0'))
+                                 << " length " << blockIndex;
+//                                hexDumpBuffer(blockBuffer,blockIndex,blockStartAddress);
+                        }
+/** We will attempt to write the page. If it doesn't write we drop out. If the
+programmer can verify the page itself in a CRC framed 'W' block, the page is not
+read back over the serial link, and if it doesn't verify we will continue
+retrying five times. Otherwise
+the page is kept for a readback pass once all pages have been written, so that
+writes don't wait on readbacks. Once written OK, bump the start address to the
+next page and reset the buffer. */
+                        sentOK = true;
+                        *errorMessage = "Write Page Failure";
+                        if (upload && verify && onboardVerify && getWriteBlockMode())
+                        {
+                            verifyOK = false;
+                            uint retryCount = 5;
+                            while (sentOK && (! verifyOK) && (retryCount > 0))
+                            {
+                                if (retryCount < 5) runMetrics->countRetry();
+                                sentOK = writeVerifyPage(blockBuffer,blockIndex,
+                                                   blockStartAddress,memType,verifyOK);
+                                retryCount--;
+                            }
+                        }
+                        else
+                        {
+                            if (upload)
+                                sentOK = writePage(blockBuffer,blockIndex,
+                                                   blockStartAddress,memType);
+                            if (sentOK && verify)
+                                writtenPages.insert(blockStartAddress,
+                                        QByteArray((const char*)blockBuffer,blockIndex));
+                        }
+      			            blockStartAddress += pageSize;
+                        blockIndex = 0;         // reset the block index
+                        updateProgress(progress);
+                    }
+    	    	    }
+            }
+            runMetrics->endPhase(phase);
+//! Read back the pages written and verify them, rewriting any that failed.
+            if (sentOK && verifyOK && ! writtenPages.isEmpty())
+            {
+                phase = runMetrics->startPhase("Readback");
+                sentOK = verifyPages(writtenPages,upload,memType,verifyOK);
+                runMetrics->endPhase(phase);
+            }
+      	    if (debugMode) qDebug() << "End of Program Load/Verify";
+  	    }
+        if (! sentOK)
+            *errorMessage = QString("File did not load properly, retry\n")+*errorMessage;
+        else if (! verifyOK)
+            *errorMessage = QString("File did not verify\nMay be temporary, retry");
+    }
+    if (! sentOK) runOutcome = RUN_LINK;
+    else if (! verifyOK) runOutcome = RUN_VERIFY;
+    else runOutcome = RUN_OK;
+    return !(sentOK && verifyOK);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read to an Intel hex file from FLASH or EEPROM.
+
+@param[in] startAddress uint start address of AVR read.
+@param[in] blockLength uint length of AVR read.
+@param[out] errorMessage Error message to print if any failure occurs.
+@param[in] file File already opened for writing.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM. Passed
+           to lower routines
+@returns boolean indicating if an error occurred.
+*/
+
+bool AvrProgrammer::readHexCore(uint startAddress, uint blockLength,
+                                QString* errorMessage,
+                                QIODevice* file, const uchar memType)
+{
+    int progress=0;
+    unchanged = false;
+    imageBytes = blockLength;
+    int phase = runMetrics->startPhase("Read");
+    bool error = ! checkProgrammingMode();
+    if (error) *errorMessage = "Programming Mode Failed";
+/* In block mode the whole range is asked for at once, and each 256 byte block is
+converted while the rest is still arriving. */
+    bool streaming = getReadBlockMode();
+    if ((! error) && streaming && (! startStreamRead(startAddress,blockLength,memType)))
+    {
+        error = true;
+        *errorMessage = "Device Read Failure";
+    }
+// Read in the memory to a buffer in 256 byte size blocks
+    while ((! error) && (blockLength > 0))
+    {
+        uint length = 256;
+        if (length > blockLength) length = blockLength;
+        uchar inBuffer[256];                // Buffer for serial read
+        bool ok;
+        if (streaming) ok = readStream(inBuffer,length);
+        else ok = readPage(inBuffer,length,startAddress,memType);
+        if (! ok)
+        {
+            error = true;
+            *errorMessage = "Device Read Failure";
+        }
+        else
+        {
+// Build Intel hex line
+            QString line = ":10"+QString("%1").arg(startAddress,4,16,QChar('0'))
+                            +"00";
+            uint bufferIndex = 0;
+            uint lineIndex = 0;
+            int checksum = (0x0F+startAddress + (startAddress >> 8)) & 0xFF;
+            int countFF = 0;            // Count null data (unprogrammed)
+            while (bufferIndex < length)
+            {
+                uchar datum = inBuffer[bufferIndex];
+                if (datum == 0xFF) countFF++;
+                checksum = (checksum + datum) & 0xFF;
+                line += QString("%1").arg(datum,2,16,QChar('0'));
+                bufferIndex++;
+                lineIndex++;
+                if ((lineIndex >= 16) || (bufferIndex >= length))
+                {
+                    line += QString("%1").arg(0xFF-checksum,2,16,QChar('0'));
+// Write the line to the file if not all FF's
+                    QTextStream out(file);
+                    if (countFF < 16) out << line + "\r\n";
+                    lineIndex = 0;
+                    startAddress += 16;
+                    checksum = (0x0F+startAddress + (startAddress >> 8)) & 0xFF;
+                    line = ":10"+QString("%1").arg(startAddress,4,16,QChar('0'))
+                            +"00";
+                    if ((progress++ & 0x0F) == 0)updateProgress(progress);
+                }
+            }
+        }
+        blockLength -= length;
+    }
+// Terminating line
+    QString line = ":00000001FF";
+    QTextStream out(file);
+    out << line + "\r\n";
+    runMetrics->endPhase(phase);
+    runOutcome = (error ? RUN_LINK : RUN_OK);
+    return error;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Check an address range against the size of the device.
+
+An end address of 0xFFFF is taken to mean the end of the memory. Anything else
+that runs past the end is refused, so that no time is spent reading memory that
+isn't there. Devices not in the part table are not checked.
+
+@param[in] startAddress First address of the range.
+@param[in,out] endAddress Last address of the range, brought back to the end
+               of the memory if given as 0xFFFF.
+@param[out] errorMessage Error message if the range is refused.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@returns true if the range is acceptable.
+*/
+
+bool AvrProgrammer::checkRange(const uint startAddress, uint& endAddress,
+                               QString* errorMessage, const uchar memType)
+{
+    uint memorySize = deviceMemorySize(memType);
+    if ((memorySize > 0) && (endAddress == 0xFFFF)) endAddress = memorySize - 1;
+    if (startAddress > endAddress)
+    {
+        *errorMessage = "Start address is beyond the end address";
+        return false;
+    }
+    if ((memorySize > 0) && (endAddress >= memorySize))
+    {
+        *errorMessage = QString("Address range runs past the end of the %1 %2 (0x%3)")
+                            .arg(deviceType).arg((memType == 'E') ? "EEPROM" : "FLASH")
+                            .arg(memorySize-1,4,16,QLatin1Char('0'));
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Size of the FLASH or EEPROM of the device.
+
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@returns size in bytes, zero if unknown.
+*/
+
+uint AvrProgrammer::deviceMemorySize(const uchar memType)
+{
+    return ((memType == 'E') ? eepromSize : flashSize);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read an Intel hex file into an image of the pages it uses.
+
+Each page is filled out with 0xFF, which is what an upload leaves in the parts
+of a page that the file doesn't cover.
+
+@param[in] file File already opened for reading.
+@param[out] image Map of page start address to page contents.
+@param[out] imageEnd If given, one past the highest address in the file.
+@returns true if the file could be interpreted.
+*/
+
+bool AvrProgrammer::parseHexFile(QIODevice* file, QMap<uint,QByteArray>& image,
+                                 uint* imageEnd)
+{
+    QTextStream stream(file);
+    bool ok = true;
+    image.clear();
+    while (! stream.atEnd() && ok)
+    {
+        QString line = stream.readLine();
+        if (! line.startsWith(':')) continue;
+        uint lineLength = line.mid(1,2).toUInt(&ok,16);
+        uint address = line.mid(3,4).toUInt(&ok,16);
+        uint recordType = line.mid(7,2).toUInt(&ok,16);
+        if (recordType == 1) break;
+        if (recordType != 0) continue;
+        for (uint lineIndex = 0; ok && (lineIndex < lineLength); lineIndex++)
+        {
+            uint page = address - address % pageSize;
+            if (! image.contains(page)) image.insert(page,QByteArray(pageSize,(char)0xFF));
+            image[page][address - page] = line.mid((lineIndex<<1)+9,2).toUInt(&ok,16);
+            address++;
+        }
+        if ((imageEnd != 0) && (address > *imageEnd)) *imageEnd = address;
+    }
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Compare the target memory with the image in a hex file.
+
+The pages used by the file are grouped into contiguous ranges, and the CRC of
+each range in the target is obtained from the programmer with 'H' and compared
+with that of the image. Only a CRC crosses the link for each range.
+
+@param[in] file File already opened for reading.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@param[out] identical true if the target holds the image.
+@returns true if the comparison could be made.
+*/
+
+bool AvrProgrammer::compareImage(QIODevice* file, const uchar memType, bool& identical)
+{
+    char inBuffer[32];
+    QMap<uint,QByteArray> image;
+    identical = false;
+    if (! parseHexFile(file,image)) return false;
+    if (image.isEmpty()) return true;
+    QMap<uint,QByteArray>::const_iterator page = image.constBegin();
+    while (page != image.constEnd())
+    {
+// Gather up the pages that follow on from each other
+        uint rangeStart = page.key();
+        QByteArray range = page.value();
+        while ((++page != image.constEnd()) && (page.key() == rangeStart + range.size()))
+            range.append(page.value());
+        if (! sendAddress(rangeStart)) return false;
+        port->putChar('H');             // Checksum a block
+        port->putChar((uchar) ((range.size() >> 8) & 0xFF));   // High Byte
+        port->putChar((uchar) (range.size() & 0xFF));          // Low byte
+        port->putChar(memType);         // indicate flash memory
+        qApp->processEvents();          // Allow send and receive to occur
+        if (debugMode) qDebug() << "Sent <H> for" << range.size() << "Bytes at"
+                                << QString("%1").arg(rangeStart,4,16,QLatin1Char('0'));
+// The whole range is read over SPI before the reply, so give it time
+        int numBytes = checkCommand(2,COMMAND_TIMEOUT*(range.size()/1024 + 1));
+        if (numBytes < 2) return false;
+        port->read(inBuffer,2);
+        quint16 targetCrc = ((uchar)inBuffer[0] << 8) + (uchar)inBuffer[1];
+        quint16 imageCrc = crc16((const uchar*)range.constData(),range.size());
+        if (debugMode) qDebug() << "Range CRC" << targetCrc << "Image CRC" << imageCrc;
+        if (targetCrc != imageCrc) return true;
+    }
+    identical = true;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Initialize by querying for programmer and device parameters.
+
+This performs all the hardware level initialization, separate from the GUI
+aspects, testing each phase in turn and aborting if there is an error
+in any of the phases.
+
+@returns boolean indicating if an error occurred.
+*/
+
+bool AvrProgrammer::initializeProgrammer(uint initialBaudrate)
+{
+    synchronized = false;
+    programmingMode = false;
+    bool sentOK = false;        // Tracks communication integrity
+/** Setup port for transmission */
+    sentOK = port->open(QIODevice::ReadWrite);
+    if (! sentOK)
+    {
+        errorMessage = QString("Unable to initialize the serial port.\n"
+                               "Check connections to the programmer.\n"
+                               "You may (but shouldn't) need root privileges.");
+        return false;
+    }
+    port->setBaudRate(bauds[initialBaudrate]);
+    port->setDataBits(QSerialPort::Data8);
+    port->setParity(QSerialPort::NoParity);
+    port->setStopBits(QSerialPort::OneStop);
+    port->setFlowControl(QSerialPort::NoFlowControl);
+    if (debugMode) qDebug() << "Initialized";
+/** A programmer left in passthrough from an earlier session must be called back
+before it will answer. */
+    releasePassThrough();
+/** Attempt to synchronize the baudrate and establish the bootloader presence.*/
+    int phase = runMetrics->startPhase("Synchronize");
+    sentOK = syncProgrammer(port,initialBaudrate);
+    runMetrics->endPhase(phase);
+    if (! sentOK)
+    {
+        errorMessage = QString("Unable to synchronize the device");
+        return false;
+    }
+    if (debugMode) qDebug() << "Synchronized";
+/** Proceed to verify the bootloader and pull in some information about its
+capabilities. In the GUI the autoAddress and block mode capabilities are
+used to set checkboxes that can be modified by the user before uploading a
+file. This allows blockmode to be turned off if desired. */
+    synchronized = true;
+    sentOK = getVersion(identifier);
+    if (! sentOK)
+    {
+        if (debugMode) qDebug() << "Failed to get Programmer Identifier.";
+        errorMessage = "Unable to get Programmer Identifier";
+        return false;
+    }
+/** Find out what the programmer can do beyond AVR109 and choose the fastest
+transfer methods it supports. */
+    sentOK = getCapabilities(capabilities);
+    if (! sentOK)
+    {
+        if (debugMode) qDebug() << "Failed to get Programmer Capabilities.";
+        errorMessage = "Unable to get Programmer Capabilities";
+        return false;
+    }
+/** The programmer's own verification replaces the readback over the link only
+when the 'W' frame is protected by a CRC, as 'K' frames are. Otherwise a byte
+damaged on the link would be written and then pass, so readback is kept. */
+    onboardVerify = ((capabilities & CAP_VERIFY) && (capabilities & CAP_CRC));
+/** A programmer that can check whether the target is still in programming mode
+is left there, so that a target left in programming mode by an earlier session
+is entered again without the reset and synchronization. */
+    if (! (capabilities & CAP_FASTENTRY))
+    {
+        sentOK = leaveProgrammingMode();
+        if (! sentOK)
+        {
+            if (debugMode) qDebug() << "Failed to leave Programming Mode.";
+            errorMessage = "Unable to leave Programming Mode";
+            return false;
+        }
+        if (debugMode) qDebug() << "Left Programming Mode";
+    }
+// Put programmer into programming mode
+    sentOK = setProgrammingMode();
+    if (! sentOK)
+    {
+        if (debugMode)
+            qDebug() << "Failed to enter Programming Mode. Check Target hardware and connections.";
+        errorMessage = "Programming Mode Failed";
+        return false;
+    }
+    if (debugMode) qDebug() << "Entered Programming Mode.";
+// Issue a signature read request
+    sentOK = getSignature(signatureArray);
+    if (! sentOK)
+    {
+        if (debugMode) qDebug() << "Failed to get Signature Bytes.";
+        errorMessage = "Unable to get Signature Bytes";
+        return false;
+    }
+// Use the signature to search for the device type, if it is in the part table
+    deviceType = "Unknown";
+    bool found=false;                   // Indicates if the target device is supported
+    uint partNo = 0;                    // Search the table for our device.
+    if (signatureArray[2] == 0x1E)
+    {
+        while ((partNo < NUMPARTS) && (! found))
+        {
+            found = ((part[partNo][0] == (uchar)signatureArray[1])
+                     && (part[partNo][1] == (uchar)signatureArray[0]));
+            partNo++;
+        }
+    }
+    lockFuse = 0;
+    partType = 0;
+    flashSize = 0;                      // Unknown sizes are not checked
+    eepromSize = 0;
+    flashPageSize = 0;
+    if (found)
+    {
+        deviceType = partName[--partNo];
+        lockFuse = part[partNo][5];
+        partType = part[partNo][2];
+        flashSize = part[partNo][6];
+        eepromSize = part[partNo][7];
+        flashPageSize = part[partNo][8];
+    }
+// Get the lock and fuse bits and display
+    sentOK = getLockFuse(lockFuse,lockBits,fuseBits,highFuseBits,extFuseBits);
+    if (! sentOK)
+    {
+        if (debugMode) qDebug() << "Failed to get Fuse/Lock Bytes.";
+        errorMessage = "Unable to get Fuse/Lock Bytes";
+        return false;
+    }
+// Issue an autoaddress confirm request
+    sentOK = getAutoAddress(autoincrement);
+    if (! sentOK)
+    {
+        if (debugMode) qDebug() << "Failed to get Autoincrement Capability.";
+        errorMessage = "Unable to get Autoincrement Capability";
+        return false;
+    }
+// Issue a block transfer support confirm request
+    sentOK = getBlockSupport(blockSupport,pageSize);
+    if (! sentOK)
+    {
+        if (debugMode) qDebug() << "Failed to get Block Support Capability.";
+        errorMessage = "Unable to get Block Support Capability";
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Debug: Dump a buffer in Hex to the screen.
+
+@param[in] blockBuffer: Read only pointer to the buffer containing the data to dump.
+@param[in] blockLength: Length of block to be dumped.
+@param[in] address: Starting address for which display is relevant.
+*/
+
+void AvrProgrammer::hexDumpBuffer(const uchar* blockBuffer,
+                              	  const uint blockLength,
+                                  const uint address)
+{
+    QString line = QString("%1: ").arg(address,2,16,QLatin1Char('0'));
+    uint lineCount = 0;
+    uint runningAddress = address;
+    for (uint blockIndex = 0; blockIndex < blockLength; blockIndex++)
+    {
+        line += QString("%1 ").arg((uchar)blockBuffer[blockIndex],2,16,QLatin1Char('0'));
+        runningAddress++;
+        if (lineCount++ >= 15)
+        {
+            qDebug() << line;
+            line = QString("%1: ").arg(runningAddress,2,16,QLatin1Char('0'));
+            lineCount = 0;
+        }
+    }
+    if (lineCount > 0) qDebug() << line;
+}
+//-----------------------------------------------------------------------------
+/** @brief Verify a set of pages, rewriting any that fail.
+
+Contiguous pages are read back together, as a single streaming read in block
+mode, and each page is compared with what was written as it arrives. Pages that
+don't match are written again if this is an upload, and only those pages are
+verified on the next pass. As with a page by page write and verify, a page gets
+five attempts.
+
+@param[in] pages Map of page start address to page contents.
+@param[in] rewrite true if pages that don't verify are to be written again.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@param[out] verifyOK true if all pages verified.
+@returns true if all writes were successful.
+*/
+
+bool AvrProgrammer::verifyPages(QMap<uint,QByteArray> pages, const bool rewrite,
+                                const uchar memType, bool& verifyOK)
+{
+    verifyOK = false;
+    uint retryCount = 5;
+    while (retryCount-- > 0)
+    {
+        QMap<uint,QByteArray> failedPages;
+        QMap<uint,QByteArray>::const_iterator page = pages.constBegin();
+        while (page != pages.constEnd())
+        {
+// Gather up the pages that follow on from each other into a single read
+            uint rangeStart = page.key();
+            uint rangeLength = 0;
+            QMap<uint,QByteArray>::const_iterator rangeEnd = page;
+            while ((rangeEnd != pages.constEnd()) &&
+                   (rangeEnd.key() == rangeStart + rangeLength))
+            {
+                rangeLength += rangeEnd.value().size();
+                ++rangeEnd;
+            }
+            bool streaming = getReadBlockMode();
+            bool readOK = true;
+            if (streaming) readOK = startStreamRead(rangeStart,rangeLength,memType);
+            for (; page != rangeEnd; ++page)
+            {
+                uchar pageBuffer[256];
+                if (readOK && streaming)
+                    readOK = readStream(pageBuffer,page.value().size());
+                else if (! streaming)
+                    readOK = readPage(pageBuffer,page.value().size(),page.key(),memType);
+                const uchar* fileBuffer = (const uchar*)page.value().constData();
+                if (readOK && (memcmp(pageBuffer,fileBuffer,page.value().size()) == 0))
+                    continue;
+                if (debugMode) hexDumpBuffer(fileBuffer,page.value().size(),page.key());
+                int index = 0;
+                while (readOK && (pageBuffer[index] == fileBuffer[index])) index++;
+                if (! readOK) qDebug() << "Read Failure at " << QString("%1").
+                                    arg(page.key(),2,16,QLatin1Char('0'));
+                else qDebug() << "Mismatch at " << QString("%1").
+                                    arg(page.key()+index,2,16,QLatin1Char('0'))
+	                     << "Device Value "
+                         << QString("0x%1")
+                                   .arg(pageBuffer[index],2,16,QLatin1Char('0'))
+                         << "Comparison Value "
+                         << QString("0x%1")
+                                   .arg(fileBuffer[index],2,16,QLatin1Char('0'));
+                failedPages.insert(page.key(),page.value());
+            }
+        }
+        if (failedPages.isEmpty())
+        {
+            verifyOK = true;
+            break;
+        }
+        runMetrics->countMismatch(failedPages.size());
+        if (rewrite && (retryCount > 0))
+        {
+            for (page = failedPages.constBegin(); page != failedPages.constEnd(); ++page)
+            {
+                runMetrics->countRetry();
+                if (! writePage((const uchar*)page.value().constData(),
+                                page.value().size(),page.key(),memType)) return false;
+            }
+        }
+        pages = failedPages;
+    }
+    if (debugMode)
+    {
+        if (verifyOK) qDebug() << "Verified OK";
+        else qDebug() << "Verification Failure";
+    }
+    return true;
+}
+/**@}*/
+/****************************************************************************/
+/** @defgroup access Device Functions to access the device
+
+These functions pull together all code that accesses the device through the
+serial communications port. They implement the various programmer commands
+needed to read device characteristics and to activate programmer actions.
+@{*/
+//-----------------------------------------------------------------------------
+/** @brief Try to establish sync with the bootloader.
+ 
+This function attempts to determine the baudrate used by the target bootloader
+by cycling the baudrate through a set of standard values and looking for a valid
+response to certain commands. No attempt is made to try different sets of serial
+formats. A common setting is assumed. We issue IDLE characters until a valid "?"
+character response is obtained. The IDLE character is defined by the acquisition
+application, but in general could be just any character. We need to timeout any
+transmission in case there is no response.
+
+Because of the possible existence of the Acquisition application also check to
+see if there is an IDLE response. If so, then give it a "jump to bootloader"
+command. In other applications this would probably have no effect but it is well
+to be aware of this code presence.
+
+A spurious "?" may occur, so check with a simple bootloader command. The
+USB-serial adaptors seem to send this when an error condition is received,
+which is likely to occur when the baudrates don't match. The number of attempts
+is limited.
+
+@param[in] port Serial port object pointer.
+@param[in] initBaudrate The baud rate to begin the search.
+@returns true if the synchronization was successful.
+*/
+
+bool AvrProgrammer::syncProgrammer(TracedSerialPort* port,
+                                   const uchar initBaudrate)
+{
+    bool ok;
+    uchar baudrate = initBaudrate;
+    char inBuffer [256];            // Read buffer to check on IDLE responses
+    uint timeout;                   // Setup a timer to deal with non-response
+    uchar attempts = 14;            // Maximum number of attempts
+    bool unsynched = true;
+    bool first = true;              // Acquisition command not yet sent
+    if (debugMode) qDebug() << "Attempt Programmer Synchronization";
+    while (unsynched)
+    {
+        if (debugMode) qDebug() << "Trying BaudRate" << bauds[baudrate];
+/** The IDLE character would be recognised by the acquisition program, so if
+an IDLE comes back we are probably in that program. However the bootloader if
+present will respond with a "?", so we are probably there.*/
+        int checkBytes = 0;             // Check if any response received
+        ok = port->putChar(IDLE_CHAR);  // Issue an IDLE character
+        timeout = TIMEOUTCOUNT;
+        while ((--timeout > 0) && (checkBytes <= 0))
+        {
+            qApp->processEvents();          // Allow send and receive to occur
+            checkBytes = port->bytesAvailable();
+            usleep(1000);
+        }
+        uint numBytes = checkBytes;
+        if (checkBytes > 0)             // If we received something
+        {
+			if (debugMode) qDebug() << QString("Received %1 Bytes").arg(checkBytes,2,16);
+            port->read(inBuffer,numBytes);
+			if (debugMode) qDebug() << QString("First Character %1").arg((uchar)inBuffer[0],2,16);
+            if ((uchar)inBuffer[0] == IDLE_CHAR)
+            {
+/** A response means the acquisition application is running, therefore try to
+send a "jump to bootloader" packet. Wait a bit to give it a chance to respond,
+so don't send it again if another IDLE_CHAR arrives, as it is likely to be the
+application still responding. Keep searching for the bootloader response.*/
+                if (first)
+                {
+                    first = false;
+                    qDebug() << "Found Possible Acquisition application";
+                    port->putChar(IDLE_CHAR);
+                    port->putChar(SYNC_CHAR);
+                    port->putChar(0x00);
+                    port->putChar(0x01);
+                    port->putChar(0x40);
+                    port->putChar(0x41);
+                    port->putChar(EOM_CHAR);
+                    qApp->processEvents();      // Allow send and receive to occur
+                    baudrate = initBaudrate;
+                }
+            }
+            else if ((QChar)inBuffer[0] == '?') // Possible bootloader found
+                unsynched = false;
+        }
+        else qDebug() << "Timeout";
+
+        if (unsynched)                  // If timeout or bad character
+        {
+            if (baudrate++ > 8) baudrate = 0;
+            port->setBaudRate(bauds[baudrate]);  // Retry with new baudrate
+            if (--attempts == 0)        // limit attempts to two cycles
+                return false;
+        }
+/** If an apparent valid bootloader response arrives, need to check that the
+bootloader is present. Use a simple command with known reply.*/
+        else
+        {
+            port->putChar('a');         // Issue a autoaddress confirm request
+            timeout = TIMEOUTCOUNT;
+            int checkBytes = 0;         // Check if any response received
+            while ((--timeout > 0) && (checkBytes <= 0))
+            {
+                qApp->processEvents();  // Allow send and receive to occur
+                checkBytes = port->bytesAvailable();
+                usleep(1000);
+            }
+            uint numBytes = checkBytes;
+            if (checkBytes > 0)         // If we received something
+            {
+				if (debugMode) qDebug() << QString("Bootloader test: Received %1 Bytes")
+                                                   .arg(checkBytes,2,16);
+                port->read(inBuffer,numBytes);
+				if (debugMode) qDebug() << QString("Character %1")
+                                                   .arg((uchar)inBuffer[0],2,16);
+                if ((uchar)inBuffer[0] == 'Y') break;
+            }
+            unsynched = true;
+            qDebug() << "Not a bootloader response";
+        }
+    }
+    if (debugMode) qDebug() << "Baudrate found " << bauds[baudrate];
+    syncBaudrate = bauds[baudrate];
+    return true;
+}
+//-----------------------------------------------------------------------------
+/** @brief Resynchronize the Programmer.
+
+Try some tricks to resynchronise the Programmer in case it is in the middle of
+a command when it got lost. Send a string of ESCs as these do not get a response
+from the Programmer but can be used to wriggle out of the middle of a command.
+Then send an 'a' command which should have one response, either 'Y' or 'N'.
+
+@returns true if a valid command was received.
+*/
+
+bool AvrProgrammer::resyncProgrammer()
+{
+    char inBuffer[256];                 // Buffer for serial read
+    runMetrics->countResync();
+    for (uchar n=0; n<64;++n)
+    {
+        port->putChar(0x1B);            // Spew out ESC characters
+        qApp->processEvents();          // Allow send and receive to occur
+    }
+    port->putChar('a');                 // Check with any command
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <a>";
+    int numBytes = checkCommand(1);
+    return readPort(inBuffer,numBytes);
+}
+//-----------------------------------------------------------------------------
+/** @brief Call the programmer back from serial passthrough.
+
+After an 'E' command the programmer passes serial data through to the target
+until it sees a BREAK or a string of ESC characters. Send both, as some USB to
+serial adaptors do not generate a BREAK. A programmer already in command mode
+ignores the ESC characters. Anything the target application has sent us is
+then discarded so that it doesn't upset the synchronization.
+*/
+
+void AvrProgrammer::releasePassThrough()
+{
+    port->setBreakEnabled(true);
+    qApp->processEvents();              // Allow send and receive to occur
+    usleep(20000);                      // Longer than a character at any baudrate
+    port->setBreakEnabled(false);
+    for (uchar n=0; n<ESCAPE_COUNT;++n)
+        port->putChar(0x1B);            // Spew out ESC characters
+    qApp->processEvents();              // Allow send and receive to occur
+    usleep(10000);
+    qApp->processEvents();
+    port->clear(QSerialPort::Input);
+    if (debugMode) qDebug() << "Sent BREAK and ESC sequence";
+}
+//-----------------------------------------------------------------------------
+/** @brief Make sure the target is in programming mode.
+
+The target may have been released to run its application by a reset command,
+in which case programming mode needs to be entered again before any access.
+
+@returns true if the target is in programming mode.
+*/
+bool AvrProgrammer::checkProgrammingMode()
+{
+    if (programmingMode) return true;
+    return setProgrammingMode();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Put device into programming mode.
+
+Programmers with the fast entry capability reuse a programming mode that is
+still active. A refresh uses 'U' instead to force a full entry, so that the
+signature and fuses are read again.
+
+@param[in] refresh Force the reset and reading of signature and fuses.
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::setProgrammingMode(const bool refresh)
+{
+    char inBuffer[32];
+    char command = (refresh ? 'U' : 'P');
+    port->putChar(command);             // Enter programming mode
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <" << command << ">";
+    int numBytes = checkCommand(1);
+    bool sentOK = (numBytes > 0);
+    if(sentOK)
+    {
+        sentOK = readPort(inBuffer,numBytes);    // Pull in response (0x0D)
+        if (inBuffer[0] == '?') sentOK = false;
+    }
+    programmingMode = sentOK;
+    return sentOK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Put device out of programming mode.
+
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::leaveProgrammingMode()
+{
+    char inBuffer[32];
+    port->putChar('L');                 // Leave programming mode
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <L>";
+    int numBytes = checkCommand(1);
+    bool sentOK = (numBytes > 0);
+    if(sentOK)
+    {
+        sentOK = readPort(inBuffer,numBytes);    // Pull in response (0x0D)
+    }
+    qApp->processEvents();              // Allow send and receive to occur
+    programmingMode = false;
+    return sentOK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Reset the target and let it run.
+
+The target reset line is pulsed and released while the programmer stays in
+command mode. Programming mode must be entered again before further access.
+
+A stock AVR109 programmer doesn't know 'X', and would be left out of step, so
+it is only sent to programmers that report the capability.
+
+@returns true if the programmer accepted the command.
+*/
+bool AvrProgrammer::resetTarget()
+{
+    char inBuffer[32];
+    if (! canRunTarget())
+    {
+        errorMessage = "The programmer can't run the target";
+        return false;
+    }
+    port->putChar('X');                 // Reset and run the target
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <X>";
+    int numBytes = checkCommand(1);
+    bool sentOK = readPort(inBuffer,numBytes);
+    if (! sentOK) errorMessage = "The programmer did not accept the reset command";
+    programmingMode = false;
+    return sentOK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Get the three signature bytes in hexadecimal form.
+
+@param[in] signature Array of three signature bytes
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::getSignature(char* signature)
+{
+    port->putChar('s');
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <s>";
+    int numBytes = checkCommand(3);
+    bool sentOK = (numBytes == 3);
+    if(sentOK)
+    {
+        sentOK = readPort(signature,numBytes);
+    }
+	if (debugMode) qDebug() << QString("Signature 0x%1%2%3")
+                       .arg((uchar)signatureArray[2],2,16,QLatin1Char('0'))
+                       .arg((uchar)signatureArray[1],2,16,QLatin1Char('0'))
+                       .arg((uchar)signatureArray[0],2,16,QLatin1Char('0'));
+    return sentOK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Get the fuse and lock bit settings in binary (uchar) form.
+
+@param[in]  lockFuse A byte holding read and write capability for the various lock/fuse bytes
+@param[out] lockBits The byte of lock bits
+@param[out] fuseBits The byte of fuse bits
+@param[out] highFuseBits The byte of high fuse bits
+@param[out] extFuseBits The byte of extended fuse bits
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::getLockFuse(const uchar lockFuse, uchar& lockBits, uchar& fuseBits,
+                                uchar& highFuseBits, uchar& extFuseBits)
+{
+    if ((lockFuse & 0x08) == 0) return true;        // Early models cannot read anything
+    char inBuffer[32];
+    bool sentOK = false;
+    lockBits = 0;
+    fuseBits = 0;
+    highFuseBits = 0;
+    extFuseBits = 0;
+    if (lockFuse & 0x01)
+    {
+        port->putChar('r');             // Issue a lock byte read  request
+        qApp->processEvents();          // Allow send and receive to occur
+	    if (debugMode) qDebug() << "Sent <r>";
+        int numBytes = checkCommand(1);
+        sentOK = (numBytes > 0);
+        if(sentOK)
+        {
+            sentOK = readPort(inBuffer,numBytes);
+            lockBits = inBuffer[0];
+        }
+    }
+    if (lockFuse & 0x02)
+    {
+        port->putChar('F');             // Issue a low Fuse byte read request
+        qApp->processEvents();          // Allow send and receive to occur
+	    if (debugMode) qDebug() << "Sent <F>";
+        int numBytes = checkCommand(1);
+        sentOK = (numBytes > 0);
+        if(sentOK)
+        {
+            sentOK = readPort(inBuffer,numBytes);
+            fuseBits = inBuffer[0];
+        }
+    }
+    if (lockFuse & 0x04)
+    {
+        port->putChar('N');             // Issue a high Fuse byte read request
+        qApp->processEvents();          // Allow send and receive to occur
+	    if (debugMode) qDebug() << "Sent <N>";
+        int numBytes = checkCommand(1);
+        sentOK = (numBytes > 0);
+        if(sentOK)
+        {
+            sentOK = readPort(inBuffer,numBytes);
+            highFuseBits = inBuffer[0];
+        }
+    }
+    if (lockFuse & 0x08)
+    {
+        port->putChar('Q');             // Issue a extended Fuse byte read request
+        qApp->processEvents();          // Allow send and receive to occur
+ 	    if (debugMode) qDebug() << "Sent <Q>";
+        int numBytes = checkCommand(1);
+        sentOK = (numBytes > 0);
+        if(sentOK)
+        {
+            sentOK = readPort(inBuffer,numBytes);
+            extFuseBits = inBuffer[0];
+        }
+    }
+    return sentOK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Get the autoaddressing capability in boolean form.
+
+@param[out] autoincrement A boolean indicating if autoincrementing is supported.
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::getAutoAddress(bool& autoincrement)
+{
+    char inBuffer[32];
+    port->putChar('a');
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <a>";
+    int numBytes = checkCommand(1);
+    bool sentOK = (numBytes > 0);
+    if(sentOK) sentOK = readPort(inBuffer,numBytes);
+    autoincrement = ((QString) inBuffer[0] == "Y");
+    return sentOK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Get the block transfer capability in boolean form.
+
+@param[out] blockSupport A boolean indicating if block transfer is supported.
+@param[out] pageSize An unsigned int of the pagesize of the device FLASH.
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::getBlockSupport(bool& blockSupport, uint& pageSize)
+{
+    char inBuffer[32];
+    port->putChar('b');
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <b>";
+    int numBytes = checkCommand(3);
+    bool sentOK = (numBytes > 0);
+    if(sentOK) sentOK = readPort(inBuffer,numBytes);
+    pageSize = ((uint) inBuffer[2] + ( (uint) inBuffer[1] << 8)) % 256;
+    blockSupport = ((inBuffer[0] == 'Y') && (pageSize > 0));
+    if (! blockSupport) pageSize = 1;
+    return sentOK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Get the Version number and Programmer Identifier in QString form.
+
+@param[out] identifier The QString containing 7 Programmer identifier characters,
+a "version" string and 2 version characters.
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::getVersion(QString& identifier)
+{
+    char inBuffer[32];
+    port->putChar('S');                 // Issue an ident command
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <S>";
+    int numBytes = checkCommand(7);
+    bool sentOK = (numBytes > 0);
+    if(sentOK) sentOK = readPort(inBuffer,numBytes);
+    inBuffer[7] = 0;
+    identifier = (QString) inBuffer;
+    port->putChar('V');                 // Issue a version command
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <V>";
+    numBytes = checkCommand(2);
+    sentOK = (numBytes > 0);
+    if(sentOK) sentOK = readPort(inBuffer,numBytes);
+    inBuffer[2] = 0;
+    identifier += " version " + (QString) inBuffer;
+	if (debugMode) qDebug() << "Identifier " << identifier;
+    return sentOK;
+}
+//-----------------------------------------------------------------------------
+/** @brief Get the programmer capabilities beyond AVR109.
+
+The 'O' command returns 'Y' and a two byte bitmap, MSB first. Older programmers
+and bootloaders answer '?', which is taken as no capabilities at all so that
+they carry on as before.
+
+@param[out] capabilities Bitmap of CAP_ capability bits.
+@returns true if the action was successful.
+*/
+bool AvrProgrammer::getCapabilities(uint& capabilities)
+{
+    char inBuffer[32];
+    capabilities = 0;
+    port->putChar('O');                 // Issue an options command
+    qApp->processEvents();              // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <O>";
+    int numBytes = checkCommand(0);     // A '?' comes alone
+    bool sentOK = (numBytes > 0);
+    if (sentOK) port->read(inBuffer,numBytes);
+    if (sentOK && (inBuffer[0] == 'Y'))
+    {
+        if (numBytes < 3)               // Bitmap may follow on behind
+            numBytes += port->read(inBuffer+numBytes,checkCommand(3-numBytes));
+        sentOK = (numBytes == 3);
+        if (sentOK) capabilities = ((uchar)inBuffer[1] << 8) + (uchar)inBuffer[2];
+    }
+    if (debugMode) qDebug() << "Capabilities" << capabilities;
+    return sentOK;
+}
+//-----------------------------------------------------------------------------
+/** @brief Write a single page to the bootloader.
+
+The buffer ends up with the two bytes stored as low byte first followed by high byte.
+A 1ms delay is inserted after each character is written to prevent the programmer
+from being swamped with serial data. This may need to be changed. At this point
+our blocklength is at most that reported by the programmer as being the page size,
+so there will be no need for additional delay while a page is being written. This
+program will synchronize with the returned acknowledgement. If the blocklength
+is later changed to be greater, then we need to break the transmissions down to
+page lengths and insert a 9ms additional delay after each page is transmitted.
+
+@param[in] blockBuffer Read only pointer to the buffer containing the data to send.
+@param[in] blockLength Length of block to be sent.
+@param[in] address Address to start programming.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@returns true if the write was successful.
+*/
+
+bool AvrProgrammer::writePage(const uchar* blockBuffer,
+                              const uint blockLength,
+                              const uint address, const uchar memType)
+{
+    if (debugMode)
+    {
+        qDebug() << "Write Individual Page from file";
+		if (debugMode)
+		{
+	        hexDumpBuffer(blockBuffer,blockLength,address);
+		}
+    }
+    char inBuffer[256];                     // Buffer for serial read
+    int numBytes;
+//    usleep(3000);                         // Insert an additional delay for programmer
+    bool writeOK = sendAddress(address);    // Starting address
+    if (!writeOK) qDebug() << "Address Setting Failure";
+//! The block mode checkbox can be used to control this behaviour.
+    if (writeOK && getWriteBlockMode() && (capabilities & CAP_CRC))
+        writeOK = writeFramedBlock(blockBuffer,blockLength,address,memType);
+    else if (writeOK && getWriteBlockMode())
+    {
+        if (debugMode) qDebug() << "Transmit Block to Target Flash Memory"
+                                << QString("%1").arg(blockLength,2,16,QLatin1Char('0'))
+                                << "Bytes";
+        port->putChar('B');                             // Write block of data
+        port->putChar((uchar) ((blockLength >> 8) & 0xFF)); // High Byte first
+        port->putChar((uchar) (blockLength & 0xFF));        // Then Low Byte
+        port->putChar(memType);                         // indicate flash memory
+        for (uint index = 0;index < blockLength;index++)
+        {
+            port->putChar(blockBuffer[index]);
+            usleep(1000);       // Delay 1 ms to allow slow programmer to catch up
+        }
+        qApp->processEvents();          // Allow send and receive to occur
+	    if (debugMode) qDebug() << "Sent <B> plus block of data";
+        numBytes = checkCommand(1);
+        writeOK = readPort(inBuffer,numBytes);
+        if (!writeOK) qDebug() << "Block Write Response Failure"
+                               << blockLength << numBytes
+                               << QString("%1").arg(inBuffer[0],2,16,QLatin1Char('0'));
+    }
+/** If block mode is not used, send each two-byte word first for the whole page
+to put it into the AVR page buffer, then reset the address back to point to the
+start of the page so that a page write command can be issued. The address then
+needs to be set again to its position at the end of the page buffer.
+
+This mode will be slower because it involves additional serial link transfers.
+
+This section relies on the blocklength being less than or equal to the page size.
+If it is larger, then the page will be overwritten.*/
+    else                       		        // Don't use block loads
+    {
+        if (debugMode) qDebug() << "Transmit Wordwise to Target Flash buffer";
+        uint index = 0;
+        while (index < blockLength)
+        {
+            port->putChar('c');       	    // lower byte sent first
+            uchar sendChar = blockBuffer[index++];
+            port->putChar(sendChar);
+            qApp->processEvents();          // Allow send and receive to occur
+		    if (debugMode) qDebug() << "Sent <c> plus low byte";
+            numBytes = checkCommand(1);
+            writeOK = readPort(inBuffer,numBytes);
+            if (!writeOK) qDebug() << "Low Byte Write Response Failure at Address:"
+                                   << QString("%1 ").arg(address,2,16,QLatin1Char('0'));
+            if (! writeOK) break;
+            port->putChar('C');       	    // upper byte sent second
+            port->putChar(blockBuffer[index++]);
+            qApp->processEvents();          // Allow send and receive to occur
+		    if (debugMode) qDebug() << "Sent <C> plus high byte";
+            numBytes = checkCommand(1);
+            writeOK = readPort(inBuffer,numBytes);
+            if (!writeOK) qDebug() << "High Byte Write Response Failure at Address:"
+                                   << QString("%1 ").arg(address,2,16,QLatin1Char('0'));
+            if (! writeOK) break;
+        }
+        if (writeOK)                   	    // Page address
+            writeOK = sendAddress(address);
+        if (writeOK)
+        {
+            if (debugMode) qDebug() << "Commit Page to Flash";
+            port->putChar('m');       	    // commit the page
+            qApp->processEvents();          // Allow send and receive to occur
+		    if (debugMode) qDebug() << "Sent <m>";
+            numBytes = checkCommand(1);
+            writeOK = readPort(inBuffer,numBytes);
+            if (!writeOK) qDebug() << "Page Write Response Failure at Address:"
+                                   << QString("%1 ").arg(address,2,16,QLatin1Char('0'))
+                                   << QString("%1").arg(inBuffer[0],2,16,QLatin1Char('0'));
+        }
+    }
+    return writeOK;
+}
+//-----------------------------------------------------------------------------
+/** @brief Write a block as a CRC framed block load.
+
+The block is sent at once with a CRC16 over the size, memory type and data. The
+programmer writes nothing unless the CRC checks out, and otherwise answers NAK
+once the link is quiet again, in which case only this frame is resent. If the
+frame is lost altogether, the programmer could still be waiting for data, so it
+is given enough padding to complete the frame and answer NAK. The address is
+sent again before each retry in case the command itself was damaged.
+
+If the programmer can decode run length encoded blocks and the encoded block,
+with the size as sent after the memory type, is smaller, that is sent instead
+('Z').
+
+If the programmer is to verify the block, it is sent with 'W', which is framed
+in the same way as 'K'. The programmer then answers '!' and the offset of the
+first mismatch if the block didn't write correctly.
+
+@param[in] blockBuffer Read only pointer to the buffer containing the data to send.
+@param[in] blockLength Length of block to be sent.
+@param[in] address Address to start programming, already sent to the programmer.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@param[out] verifyOK If given, the block is verified by the programmer, and
+            this is true if it was written correctly.
+@returns true if the write was successful.
+*/
+
+bool AvrProgrammer::writeFramedBlock(const uchar* blockBuffer,
+                                     const uint blockLength,
+                                     const uint address, const uchar memType,
+                                     bool* verifyOK)
+{
+    char inBuffer[256];                     // Buffer for serial read
+    QByteArray frame;
+    QByteArray encoded;
+    bool compressed = false;
+    if ((verifyOK == 0) && (capabilities & CAP_RLELOAD))
+    {
+        encoded = rleEncode(blockBuffer,blockLength);
+// The encoded block carries two more bytes of header, the size as sent
+        compressed = ((uint)encoded.size() + 2 < blockLength);
+    }
+    if (verifyOK != 0) frame.append('W');               // Verified block load
+    else frame.append(compressed ? 'Z' : 'K');          // CRC framed block load
+    frame.append((char) ((blockLength >> 8) & 0xFF));   // High Byte first
+    frame.append((char) (blockLength & 0xFF));          // Then Low Byte
+    frame.append(memType);                              // indicate flash memory
+    if (compressed)
+    {
+        frame.append((char) ((encoded.size() >> 8) & 0xFF));
+        frame.append((char) (encoded.size() & 0xFF));
+        frame.append(encoded);
+    }
+    else frame.append((const char*)blockBuffer,blockLength);
+    quint16 crc = crc16((const uchar*)frame.constData()+1,frame.size()-1);
+    frame.append((char) ((crc >> 8) & 0xFF));           // CRC High Byte first
+    frame.append((char) (crc & 0xFF));
+    bool writeOK = true;
+    for (uint retry = 0; retry < FRAME_RETRIES; retry++)
+    {
+        if (retry > 0)
+        {
+            runMetrics->countRetry();
+            writeOK = sendAddress(address);
+        }
+        if (! writeOK) break;
+        port->write(frame);
+        qApp->processEvents();          // Allow send and receive to occur
+        if (debugMode) qDebug() << "Sent <" << frame[0] << "> plus block of data"
+                                << frame.size() << "Bytes" << retry;
+        int numBytes = checkCommand(1);
+        if (numBytes > 0) port->read(inBuffer,numBytes);
+        if ((numBytes > 0) && (inBuffer[0] == '\r'))
+        {
+            if (verifyOK != 0) *verifyOK = true;
+            return true;
+        }
+        if ((numBytes > 0) && (inBuffer[0] == '!') && (verifyOK != 0))
+        {
+            if (numBytes < 3)           // Offset may follow on behind
+                port->read(inBuffer+numBytes,checkCommand(3-numBytes));
+            uint offset = ((uchar)inBuffer[1] << 8) + (uchar)inBuffer[2];
+            qDebug() << "Mismatch at " << QString("%1").
+                                arg(address+offset,2,16,QLatin1Char('0'));
+            runMetrics->countMismatch();
+            *verifyOK = false;
+            return true;
+        }
+        if ((numBytes > 0) && (inBuffer[0] == NAK_CHAR))
+            qDebug() << "Block Frame NAK at Address:"
+                     << QString("%1 ").arg(address,2,16,QLatin1Char('0'));
+/* Frame lost or mistaken for something else, so pad it out and discard what
+comes back. */
+        else
+        {
+            qDebug() << "Block Frame Failure at Address:"
+                     << QString("%1 ").arg(address,2,16,QLatin1Char('0'))
+                     << numBytes << "Bytes Received";
+            port->write(QByteArray(FRAME_FLUSH,0x1B));
+            qApp->processEvents();
+            checkCommand(1);
+            port->clear(QSerialPort::Input);
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Run length encode a block for the programmer.
+
+A run of more than three identical bytes becomes RLE_MARKER, count, value. The
+marker itself is always sent that way, so that it is never taken as a literal.
+Anything else is sent as it is.
+
+@param[in] data Pointer to the bytes to encode.
+@param[in] length Number of bytes.
+@returns The encoded bytes.
+*/
+
+QByteArray AvrProgrammer::rleEncode(const uchar* data, const uint length)
+{
+    QByteArray encoded;
+    uint index = 0;
+    while (index < length)
+    {
+        uint run = 1;
+        while ((index+run < length) && (run < 255) && (data[index+run] == data[index]))
+            run++;
+        if ((run > 3) || (data[index] == RLE_MARKER))
+        {
+            encoded.append((char) RLE_MARKER);
+            encoded.append((char) run);
+            encoded.append((char) data[index]);
+        }
+        else encoded.append((const char*)data+index,run);
+        index += run;
+    }
+    return encoded;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Compute a CRC16 as used by the programmer.
+
+This is the XMODEM CRC (polynomial 0x1021, no reflection), as computed by the
+avr-libc _crc_xmodem_update function.
+
+@param[in] data Pointer to the bytes to cover.
+@param[in] length Number of bytes.
+@param[in] crc Starting value, allowing a CRC to be continued.
+@returns The CRC.
+*/
+
+quint16 AvrProgrammer::crc16(const uchar* data, const uint length, quint16 crc)
+{
+    for (uint index = 0; index < length; index++)
+    {
+        crc ^= ((quint16)data[index] << 8);
+        for (uint bit = 0; bit < 8; bit++)
+        {
+            if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+            else crc <<= 1;
+        }
+    }
+    return crc;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Write a single page and have the programmer verify it.
+
+The 'W' command is a CRC framed block load that the programmer holds in RAM,
+commits and then reads back over the SPI interface for comparison. The CRC
+makes sure that the RAM copy is what was sent, so that the comparison is as
+good as a readback over the link. A frame damaged on the link is resent as for
+'K'. The block must not exceed the programmer's page buffer, which is always the
+case for blocks of at most the reported page size.
+
+@param[in] blockBuffer Read only pointer to the buffer containing the data to send.
+@param[in] blockLength Length of block to be sent.
+@param[in] address Address to start programming.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@param[out] verifyOK true if the programmer found the page written correctly.
+@returns true if the write was successful.
+*/
+
+bool AvrProgrammer::writeVerifyPage(const uchar* blockBuffer,
+                                    const uint blockLength,
+                                    const uint address, const uchar memType,
+                                    bool& verifyOK)
+{
+    if (debugMode)
+    {
+        qDebug() << "Write and Verify Individual Page from file";
+        hexDumpBuffer(blockBuffer,blockLength,address);
+    }
+    verifyOK = false;
+    bool writeOK = sendAddress(address);    // Starting address
+    if (!writeOK) qDebug() << "Address Setting Failure";
+    if (writeOK)
+    {
+        writeOK = writeFramedBlock(blockBuffer,blockLength,address,memType,
+                                   &verifyOK);
+        if (!writeOK) qDebug() << "Block Write Response Failure" << blockLength;
+    }
+    if (debugMode)
+    {
+        if (verifyOK) qDebug() << "Verified OK";
+        else qDebug() << "Verification Failure";
+    }
+    return writeOK;
+}
+//-----------------------------------------------------------------------------
+/** @brief Read a single page from the bootloader
+
+Read a page from the device memory into a buffer. If the programmer can run
+length encode block reads, that is used as it shrinks mostly erased memory.
+
+@param[in] blockBuffer Pointer to a buffer to contain the data.
+@param[in] blockLength Length of block to read.
+@param[in] address Address to start reading.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@returns true if the read was successful.
+*/
+
+bool AvrProgrammer::readPage(uchar* blockBuffer,
+                             const uint blockLength,
+                             const uint address, const uchar memType)
+{
+    char inBuffer[256];                 // Buffer for serial read
+    int numBytes = blockLength;
+    bool readOK = true;
+//! The block mode checkbox can be used to control this behaviour.
+    if (getReadBlockMode())
+    {
+        if (debugMode) qDebug() << "Read Block from Target Memory"
+                                << QString("%1").arg(blockLength,2,16,QLatin1Char('0'))
+                                << "Bytes";
+        readOK = startStreamRead(address,blockLength,memType);
+        if (readOK) readOK = readStream(blockBuffer,blockLength);
+        if (! readOK) qDebug() << "Read Fail";
+    }
+/** If block mode is not used, read each two-byte word for the whole page.
+Word comes as low first then high.*/
+    else if (sendAddress(address))          // Don't use block loads
+    {
+        if (debugMode) qDebug() << "Read Page Wordwise from Target Flash Memory";
+        uint bufferIndex = 0;
+        while (bufferIndex < blockLength)
+        {
+            port->putChar('R');             // Read word
+            qApp->processEvents();          // Allow send and receive to occur
+		    if (debugMode) qDebug() << "Sent <R>";
+            readOK = (checkCommand(2) == 2);
+            if (! readOK)
+            {
+                qDebug() << "Read Fail";
+                break;
+            }
+            port->read(inBuffer,2);
+            blockBuffer[bufferIndex++] = inBuffer[1];
+            blockBuffer[bufferIndex++] = inBuffer[0];
+        }
+    }
+    else readOK = false;
+    if (debugMode)
+    {
+        qDebug() << "Target Flash Memory Contents Read"
+             << QString("Address 0x%1").arg((uchar)address,2,16,QLatin1Char('0'))
+             << QString("BlockLength 0x%1").arg((uchar)blockLength,2,16,QLatin1Char('0'))
+             << numBytes;
+        hexDumpBuffer(blockBuffer,blockLength,address);
+    }
+    return readOK;
+}
+//-----------------------------------------------------------------------------
+/** @brief Start a streaming read of a range of memory.
+
+The range is asked for in as few block reads as the programmer allows, and the
+data is then taken up with readStream as it arrives, so that the caller can get
+on with it while the rest is still coming. The programmer always sends whole
+FLASH words, so an odd length has a byte over which is thrown away.
+
+@param[in] address Address to start reading.
+@param[in] length Number of bytes to read.
+@param[in] memType 'F' indicates flash memory, and 'E' indicates EEPROM
+@returns true if the first block read was accepted.
+*/
+
+bool AvrProgrammer::startStreamRead(const uint address, const uint length,
+                                    const uchar memType)
+{
+    streamAddress = address;
+    streamMemType = memType;
+    streamWanted = length;
+    streamUnrequested = length;
+    if (memType == 'F') streamUnrequested += (length & 1);
+    streamPending = 0;
+    streamHeld.clear();
+    streamData.clear();
+    if (requestStream()) return true;
+    abortStream();
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Ask for the next block of a streaming read.
+
+If the programmer can run length encode block reads, that is used as it shrinks
+mostly erased memory.
+
+@returns true if the address was accepted.
+*/
+
+bool AvrProgrammer::requestStream()
+{
+    uint length = streamUnrequested;
+    if (length > STREAM_BLOCK) length = STREAM_BLOCK;
+    if (! sendAddress(streamAddress)) return false;
+    char command = ((capabilities & CAP_RLEREAD) ? 'G' : 'g');
+    port->putChar(command);         // Read a block of memory
+    port->putChar((uchar) ((length >> 8) & 0xFF));     //High Byte
+    port->putChar((uchar) (length & 0xFF));            // Low byte
+    port->putChar(streamMemType);   // indicate flash memory
+    qApp->processEvents();          // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent <" << command << "> for" << length << "Bytes";
+    streamAddress += length;
+    streamUnrequested -= length;
+    streamPending = length;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Take up whatever has arrived of a streaming read.
+
+Encoded runs come as RLE_MARKER, count, value and anything else is a literal.
+A run that is split across arrivals is held over until the rest of it is in.
+When a block has all come in, the next is asked for.
+
+@returns false if nothing arrived in time.
+*/
+
+bool AvrProgrammer::fetchStream()
+{
+    if ((streamPending == 0) && (streamUnrequested > 0) && (! requestStream()))
+        return false;
+    uint timeout = 0;
+    qApp->processEvents();          // Allow for received data to appear
+    while (port->bytesAvailable() <= 0)
+    {
+        if (++timeout >= 300)
+        {
+            qDebug() << "Stream Read Timeout" << streamPending << "Bytes Outstanding";
+            return false;
+        }
+        usleep(1000);
+        qApp->processEvents();
+    }
+    streamHeld.append(port->readAll());
+    if (! (capabilities & CAP_RLEREAD))
+    {
+        streamData.append(streamHeld);
+        streamPending -= qMin(streamPending,(uint)streamHeld.size());
+        streamHeld.clear();
+        return true;
+    }
+    int index = 0;
+    while ((index < streamHeld.size()) && (streamPending > 0))
+    {
+        char datum = streamHeld[index];
+        uint run = 1;
+        if ((uchar)datum == RLE_MARKER)
+        {
+            if (index+3 > streamHeld.size()) break;     // Rest of run to come
+            run = (uchar)streamHeld[index+1];
+            datum = streamHeld[index+2];
+            index += 2;
+        }
+        index++;
+        if (run > streamPending) run = streamPending;
+        streamData.append(QByteArray(run,datum));
+        streamPending -= run;
+    }
+    streamHeld.remove(0,index);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read the next part of a streaming read.
+
+This returns as soon as the part has come in, leaving the rest of the stream to
+carry on arriving.
+
+@param[out] blockBuffer Pointer to a buffer to contain the data.
+@param[in] blockLength Number of bytes wanted.
+@returns true if the bytes were read.
+*/
+
+bool AvrProgrammer::readStream(uchar* blockBuffer, const uint blockLength)
+{
+    if (blockLength > streamWanted)
+    {
+        abortStream();
+        return false;
+    }
+    while ((uint)streamData.size() < blockLength)
+        if (! fetchStream())
+        {
+            abortStream();
+            return false;
+        }
+    memcpy(blockBuffer,streamData.constData(),blockLength);
+    streamData.remove(0,blockLength);
+    streamWanted -= blockLength;
+// Make sure that any byte over has come in, so it isn't taken as a response
+    while ((streamWanted == 0) && (streamPending > 0))
+        if (! fetchStream())
+        {
+            abortStream();
+            return false;
+        }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Give up on a streaming read that has failed part way.
+
+The rest of a block may still be on its way, so the port is drained until it
+goes quiet, otherwise the late bytes would be taken as the response to the next
+command. The stream is then left empty.
+*/
+
+void AvrProgrammer::abortStream()
+{
+    if (debugMode) qDebug() << "Stream Abandoned" << streamWanted << "Bytes Wanted";
+    uint quiet = 0;
+    port->clear();
+    while (quiet++ < TIMEOUTCOUNT)
+    {
+        usleep(1000);
+        qApp->processEvents();
+        if (port->bytesAvailable() > 0)
+        {
+            port->readAll();
+            quiet = 0;
+        }
+    }
+    port->clear();
+    streamWanted = 0;
+    streamUnrequested = 0;
+    streamPending = 0;
+    streamHeld.clear();
+    streamData.clear();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Set the FLASH address in the bootloader.
+
+The address is sent MSB first, then LSB
+
+@param[in] address Address to be set.
+@returns true if the command was valid.
+*/
+
+bool AvrProgrammer::sendAddress(const uint address)
+{
+    char inBuffer[256];                 // Buffer for serial read
+    uint wordAddress = (address >> 1);  // word address
+    bool sendOK = false;
+    for (uint i = 0; i < 2; i++)        // Give it a couple of tries
+    {
+        if (i > 0) runMetrics->countRetry();
+        port->putChar('A');             // address command
+        port->putChar((uchar) ((wordAddress >> 8) & 0xFF));
+        port->putChar((uchar) (wordAddress & 0xFF));
+        qApp->processEvents();          // Allow send and receive to occur
+	    if (debugMode) qDebug() << "Sent <V> plus address";
+        int numBytes = checkCommand(1);
+        sendOK = readPort(inBuffer,numBytes);
+		if (debugMode)
+		{
+	        qDebug() << "Send Address. numbytes: " << numBytes
+                     << sendOK << "Index " << i;
+		}
+        if (sendOK) break;
+        else resyncProgrammer();
+    }
+    return sendOK;
+}
+//-----------------------------------------------------------------------------
+/** @brief Read the port and check for a valid AVRPROG command.
+
+This is intended to pull in a response to a command and basically just
+checks that the command is valid (an invalid command will elicit a response
+'?' from the bootloader). Do not use this while reading binary data as a '?' may
+occur in the data stream. Use only for commands. A side effect is that an error
+in the serial interface can result in a '?' character being returned. This has
+been noticed with a serial to USB converter.
+
+@param[out] inBuffer Pointer to the buffer that will receive the read data.
+@param[in] numBytes Number of bytes to be read. This will block until all the
+requested bytes have been read.
+@returns false if numBytes is zero, or a '?' is the first character.
+*/
+
+bool AvrProgrammer::readPort(char* inBuffer, const int numBytes)
+{
+    qApp->processEvents();          // Allow send and receive to occur
+    if ((numBytes == 0)) return false;
+    port->read(inBuffer,numBytes);
+    return !(inBuffer[0] == '?');
+}
+//-----------------------------------------------------------------------------
+/** @brief Check an AVRPROG command.
+
+This does not read the port but checks for the presence of waiting characters.
+When the number waiting equals the expected number, or a timeout occurs, the
+function returns. This provides the subsequent read call with all the characters
+needed to complete its task without complications.
+
+At least one byte is always returned by an AVRPROG command except for the ESC
+command. If the expected bytes is specified as zero, the function will
+return for any non-zero number of bytes, otherwise it will return only when
+the specified number of bytes is received.
+
+The timeout is programmed to avoid program hangs if the serial interface is
+interrupted. However there is no error condition returned so the program merrily
+continues on. Make sure the timeout count is set to a high enough value to allow
+for slow links. You will be sure of this when the avr program uploads without
+errors.
+
+The value of 300ms is used for timeout to accomodate the programmer's attempts
+to enter programming mode, which will take over 250ms on failure. Commands that
+take longer before they answer can give a longer timeout.
+
+@param[in] expectedBytes: The number of bytes expected to be returned.
+@param[in] timeoutCount: Time to wait for the response (ms).
+@returns Number of bytes actually received (0 if timeout).
+*/
+
+int AvrProgrammer::checkCommand(const int expectedBytes, const uint timeoutCount)
+{
+    uint timeout = 0;               // Setup a timer to deal with non-response
+    int numBytes = 0;               // Check if any response received
+    int numBytesPrevious = 0;
+    qint64 latency = 0;             // Time from sending to the last arrival
+    bool match = false;
+    roundTrips++;
+    while ((++timeout < timeoutCount) && (! match))
+    {
+        qApp->processEvents();      // Allow for received data to appear
+        numBytes = port->bytesAvailable();
+        if (expectedBytes > 0)
+        {
+            match = (numBytes == expectedBytes);
+        }
+        else
+            match = (numBytes > 0);
+        if (numBytes > numBytesPrevious)
+        {
+            timeout = 0;            // Reset timeout as we are getting something
+            latency = port->sinceWrite();
+        }
+        numBytesPrevious = numBytes;
+        usleep(1000);
+    }
+    if (numBytes < 0) numBytes = 0;
+    runMetrics->response(port->command(),latency,numBytes > 0);
+    if (!match) qDebug() << "Check-Command Timeout" << numBytes
+                         << "Bytes Received" << expectedBytes << "Expected";
+    return numBytes;
+}
+//-----------------------------------------------------------------------------
+/** @brief Send a single character command to the programmer.
+
+This is used to command the programmer without needing a response.
+
+@param[in] command. A single character.
+*/
+
+void AvrProgrammer::sendCommand(const char command)
+{
+    char inBuffer[16];
+    int numBytes;
+    port->putChar(command);
+    qApp->processEvents();          // Allow send and receive to occur
+    if (debugMode) qDebug() << "Sent " << command;
+    numBytes = checkCommand(1);
+    readPort(inBuffer,numBytes);
+}
+/**@}*/
+//-----------------------------------------------------------------------------
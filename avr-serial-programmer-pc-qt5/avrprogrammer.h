@@ -0,0 +1,222 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef AVR_PROGRAMMER_H
+#define AVR_PROGRAMMER_H
+#define _TTY_POSIX_         // Need to tell qextserialport we are in POSIX
+
+#include <QString>
+#include <QDir>
+#include <QFile>
+#include <QSerialPort>
+#include <QMap>
+#include <QByteArray>
+#include "serialtrace.h"
+#include "metrics.h"
+
+//-----------------------------------------------------------------------------
+/** @brief AVR Serial Programmer engine.
+
+This class talks to an AVRPROG bootloader or programmer, which it synchronizes
+with when it is made. The AVRPROG bootloader is described in Atmel's application
+note AVR109 and supports a small set of commands for programming and checking
+the FLASH program ROM in an AVR microcontroller.
+
+The programming and checking can sometimes be a bit unreliable, particularly if
+the serial speed is a bit high, whence the AVR buffer may become overloaded for
+long blocks. Using non-block transfers requires a lot more serial line traffic
+and is therefore several times slower.
+
+The entire programming and checking code is contained in this module. It needs
+only the Qt core and serial port modules, so that it can be used without a
+display. A user interface can replace the progress display and the block mode
+settings, as the dialog in avrserialprog.h does.
+
+The class is defined such that it can be incorporated at compile time into
+other programs for the purpose of adding a firmware upload feature. The serial
+port is defined in the main program. Thus a calling program must define the
+port in a compatible way with the port used for its own operations.
+*/
+
+/* Capability bits reported by a programmer in answer to the 'O' command */
+#define CAP_VERIFY      0x0001      //!< 'W' CRC framed block load verified by the programmer
+#define CAP_RUN         0x0002      //!< 'X' target run, passthrough can be left
+#define CAP_DATAPOLL    0x0004      //!< Data polling for targets without busy flag
+#define CAP_FASTENTRY   0x0008      //!< 'P' reuses programming mode, 'U' refreshes
+#define CAP_CRC         0x0010      //!< 'K' CRC framed block load
+#define CAP_RLELOAD     0x0020      //!< 'Z' run length encoded framed block load
+#define CAP_RLEREAD     0x0040      //!< 'G' run length encoded block read
+#define CAP_CHECKSUM    0x0080      //!< 'H' CRC of a block
+
+/* Longest wait for a chip erase, in response timeouts */
+#define ERASE_WAITS 10
+
+enum param {VERIFY,UPLOAD,DEBUG,READBLOCKMODE,WRITEBLOCKMODE,
+            PASSTHROUGH,AUTOINCREMENTMODE,RUNTARGET,ONBOARDVERIFY,
+            SKIPIDENTICAL};
+
+/* Outcome of a command line run, also used as the program's exit status */
+enum outcome {RUN_OK,RUN_USAGE,RUN_NOPROGRAMMER,RUN_FILE,RUN_LINK,RUN_VERIFY};
+
+class AvrProgrammer
+{
+public:
+    AvrProgrammer(QString*, uint initialBaudrate,bool debug,
+                  const QString traceFile = QString());
+    virtual ~AvrProgrammer();
+    bool success();
+    QString error();
+    uint roundTripCount();
+    bool canRunTarget();
+    const ProgrammerMetrics& metrics();
+    void printMetrics();
+    outcome result();
+    void refuseRun(const QString message);
+    QByteArray jsonReport(const QString filename);
+    void setMetricsFile(const QString fileName, const bool replace = false);
+    bool exportMetrics();
+    void setParameter(param parameter, bool value);
+    void printDetails();
+    bool uploadHex(QString filename);
+    bool downloadHex(QString filename,int startAddress, int endAddress);
+    bool resetTarget();
+    void quitProgrammer();
+protected:
+    virtual bool getReadBlockMode();
+    virtual bool getWriteBlockMode();
+    virtual void updateProgress(int progress);
+    QString resultName();
+    double runSeconds();
+    bool initializeProgrammer(uint initialBaudrate);
+    bool loadHexCore(bool upload, bool verify, QString* errorMessage,
+                     QIODevice* file, const uchar memType);
+    bool checkRange(const uint startAddress, uint& endAddress,
+                    QString* errorMessage, const uchar memType);
+    uint deviceMemorySize(const uchar memType);
+    bool parseHexFile(QIODevice* file, QMap<uint,QByteArray>& image,
+                      uint* imageEnd = 0);
+    bool compareImage(QIODevice* file, const uchar memType, bool& identical);
+    bool readHexCore(uint startAddress, uint blockLength, QString* errorMessage,
+                     QIODevice* file, const uchar memType);
+    void hexDumpBuffer(const uchar* blockBuffer,
+                       const uint blockLength,
+                       const uint address);
+    bool verifyPages(QMap<uint,QByteArray> pages, const bool rewrite,
+                     const uchar memType, bool& verifyOK);
+    bool syncProgrammer(TracedSerialPort* port,const uchar baudrate);
+    bool resyncProgrammer();
+    void releasePassThrough();
+    bool checkProgrammingMode();
+    bool setProgrammingMode(const bool refresh = false);
+    bool leaveProgrammingMode();
+    bool getSignature(char* signature);
+    bool getLockFuse(const uchar lockFuse, uchar& lockBits, uchar& fuseBits,
+                                uchar& highFuseBits, uchar& extFuseBits);
+    bool getAutoAddress(bool& autoAddress);
+    bool getBlockSupport(bool& blockSupport, uint& pageSize);
+    bool getVersion(QString& identifier);
+    bool getCapabilities(uint& capabilities);
+    bool writePage(const uchar* blockBuffer,
+                   const uint blockLength,
+                   const uint address, const uchar memType);
+    bool writeFramedBlock(const uchar* blockBuffer,
+                   const uint blockLength,
+                   const uint address, const uchar memType,
+                   bool* verifyOK = 0);
+    QByteArray rleEncode(const uchar* data, const uint length);
+    quint16 crc16(const uchar* data, const uint length, quint16 crc = 0);
+    bool writeVerifyPage(const uchar* blockBuffer,
+                   const uint blockLength,
+                   const uint address, const uchar memType,
+                   bool& verifyOK);
+    bool readPage(uchar* blockBuffer,
+                   const uint blockLength,
+                   const uint address, const uchar memType);
+    bool startStreamRead(const uint address, const uint length,
+                         const uchar memType);
+    bool requestStream();
+    bool fetchStream();
+    bool readStream(uchar* blockBuffer, const uint blockLength);
+    void abortStream();
+    bool sendAddress(const uint address);
+    bool readPort(char* inBuffer, const int numBytes);
+    int  checkCommand(const int expectedBytes, const uint timeoutCount = 300);
+    void sendCommand(const char command);
+    TracedSerialPort* port;     //!< Serial port object pointer
+    SerialTrace* trace;         //!< Record of the link traffic, null if off
+    QString traceFileName;      //!< File the trace is saved to at the end
+    ProgrammerMetrics* runMetrics;  //!< Where the time went in the last run
+    QString metricsFileName;    //!< Prometheus text file, if any
+    bool metricsReplace;        //!< Don't carry counters over from the file
+    qint32 syncBaudrate;        //!< Baud rate the programmer answered at
+    bool synchronized;          //!< Synchronization status
+    bool queried;               //!< All device and programmer details obtained
+    bool programmingMode;       //!< Target is held in programming mode
+    QString errorMessage;       //!< Messages for the calling application
+    QDir saveDirectory;
+    QString saveFile;
+    QFile* outFile;
+    QString identifier;         //!< AVR109 bootloader ID
+    uchar lockFuse;             //!< Lock and Fuse capability byte
+    uchar lockBits;
+    uchar fuseBits;
+    uchar highFuseBits;
+    uchar extFuseBits;
+    char signatureArray[3];
+    bool autoincrement;         //!< If address is autoincremented
+    bool blockSupport;          //!< If blocks of data can be sent at once
+    uint capabilities;          //!< Programmer extensions beyond AVR109
+    uint pageSize;              //!< Size of FLASH pages for writing.
+    QString deviceType;         //!< Symbolic microcontroller type name
+    uint partType;              //!< Part Type symbol
+    uint flashSize;             //!< FLASH size in bytes, zero if unknown
+    uint eepromSize;            //!< EEPROM size in bytes
+    uint flashPageSize;         //!< FLASH page size in words
+// Control parameters
+    bool verify;
+    bool upload;
+    bool debugMode;
+    bool readBlockMode;
+    bool writeBlockMode;
+    bool autoincrementMode;
+    bool passThrough;
+    bool runTarget;
+    bool onboardVerify;         //!< Programmer verifies pages it writes
+// Streaming read state
+    uint streamAddress;         //!< Next address to ask for
+    uchar streamMemType;        //!< Memory being read
+    uint streamWanted;          //!< Bytes still to be handed over
+    uint streamUnrequested;     //!< Bytes not yet asked for
+    uint streamPending;         //!< Bytes of the current block still to come
+    QByteArray streamHeld;      //!< Received data not yet decoded
+    QByteArray streamData;      //!< Decoded data not yet handed over
+    bool skipIdentical;         //!< Don't program a target that holds the image
+    bool unchanged;             //!< Last load found the image already there
+    uint roundTrips;            //!< Responses waited for
+    outcome runOutcome;         //!< How the last upload or download went
+    uint imageBytes;            //!< Bytes in the last image loaded or read
+};
+
+#endif
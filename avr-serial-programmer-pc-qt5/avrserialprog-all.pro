@@ -0,0 +1,24 @@
+# Builds the core library, then the window, the command line program, the
+# benchmark and the C interface library that link it.
+# Build with: qmake avrserialprog-all.pro && make
+
+TEMPLATE =      subdirs
+
+core.file       = avrserialprog-core.pro
+core.makefile   = Makefile.core
+gui.file        = avrserialprog.pro
+gui.makefile    = Makefile.gui
+gui.depends     = core
+cli.file        = avrserialprog-cli.pro
+cli.makefile    = Makefile.cli
+cli.depends     = core
+bench.file      = avrserialprog-bench.pro
+bench.makefile  = Makefile.bench
+bench.depends   = core
+lib.file        = avrserialprog-lib.pro
+lib.makefile    = Makefile.lib
+lib.depends     = core
+
+SUBDIRS         = core gui cli lib
+# The benchmark's images are made with QRandomGenerator, from Qt 5.10
+greaterThan(QT_MAJOR_VERSION, 5)|greaterThan(QT_MINOR_VERSION, 9): SUBDIRS += bench
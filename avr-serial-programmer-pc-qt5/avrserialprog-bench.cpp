@@ -0,0 +1,393 @@
+/**
+@file avrserialprog-bench.cpp
+@brief Throughput benchmark of the programming engine
+
+@details The AvrProgrammer upload, verify and read paths are driven against
+the programmer emulator over a matrix of baud rates, block and word transfers,
+FLASH page sizes and sparse or dense images. One line of CSV is written for
+each phase of each combination, giving the bytes per second, the round trips
+(responses waited for) per page, and the wall time.
+
+A fresh emulator is started for each combination, so that every upload starts
+from an erased target.
+
+With -f, faults are injected on the emulator's serial link to measure the
+programmer's retries and resynchronisation. Each combination is then run once
+without faults and again for each of a number of fault generator seeds. The
+extra time each phase takes over the fault free run is its recovery time, and
+the success rate and mean recovery time of each phase are reported on stderr
+when the runs are done. The seeds make the runs repeatable. A run that goes past
+its deadline has the emulator stopped under it, and the phases not finished in
+time are counted as failed.
+
+The page sizes come from the parts the emulator can simulate: 8 words
+(ATTiny441), 16 (ATTiny2313), 32 (ATMega88) and 64 (ATMega328).
+
+Options:
+- -e path     emulator executable, default ../avr-serial-programmer-emulator/
+              avr-serial-programmer-emulator
+- -b list     baud rates, comma separated, default 19200,38400,57600
+- -p list     page sizes in words, comma separated, default 8,16,32,64
+- -s size     image span in bytes, default 4096 (or the FLASH size if smaller)
+- -t scale    emulator time scale, default 1 (real time)
+- -f faults   faults to inject, as the emulator's -f option
+- -n runs     runs with faults for each combination, default 10
+- -w seconds  deadline for each run, default 300
+- -d          show the programmer's debug messages
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                      *
+ *   ksarkies@trinity.asn.au                                                *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <QCoreApplication>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+#include <unistd.h>
+#include <cstdio>
+#include "avrprogrammer.h"
+
+#define EMULATOR "../avr-serial-programmer-emulator/avr-serial-programmer-emulator"
+
+/* Parts simulated for each page size, with their FLASH sizes */
+struct BenchPart
+{
+    uint pageWords;
+    const char* name;
+    uint flashSize;
+};
+const BenchPart benchParts[] = {
+    {  8, "ATTiny441",   4096 },
+    { 16, "ATTiny2313",  2048 },
+    { 32, "ATMega88",    8192 },
+    { 64, "ATMega328",  32768 }
+};
+const uint numBenchParts = sizeof(benchParts)/sizeof(benchParts[0]);
+
+/* Baud rates in the order of the programmer's baud rate index */
+const uint benchBauds[] = {1200,2400,4800,9600,19200,38400,57600};
+const uint numBenchBauds = sizeof(benchBauds)/sizeof(benchBauds[0]);
+
+/* Outcome of one phase of a run */
+struct PhaseResult
+{
+    bool ok;
+    double seconds;
+    uint trips;
+};
+const char* phaseName[] = {"upload","verify","read"};
+const uint numPhases = 3;
+
+static bool showDebug = false;
+
+//-----------------------------------------------------------------------------
+/** @brief Drop the programmer's messages unless asked for */
+
+static void messageHandler(QtMsgType type, const QMessageLogContext& context,
+                           const QString& message)
+{
+    Q_UNUSED(context);
+    if (showDebug || (type != QtDebugMsg))
+        fprintf(stderr,"%s\n",message.toLocal8Bit().constData());
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Write an Intel hex image
+
+A dense image fills the whole span with random data. A sparse image fills only
+every fourth page, leaving gaps for the programmer to skip. Records are 16
+bytes, which divides every page size.
+
+@param[in] fileName Hex file to write.
+@param[in] span Size of the address range covered, in bytes.
+@param[in] pageBytes FLASH page size in bytes.
+@param[in] sparse Leave out three pages in every four.
+@param[in] generator Source of the data, seeded so that images repeat.
+@returns Number of data bytes in the image.
+*/
+
+static uint writeImage(const QString fileName, const uint span,
+                       const uint pageBytes, const bool sparse,
+                       QRandomGenerator& generator)
+{
+    QFile file(fileName);
+    if (! file.open(QIODevice::WriteOnly | QIODevice::Text)) return 0;
+    QTextStream out(&file);
+    uint bytes = 0;
+    for (uint address = 0; address < span; address += 16)
+    {
+        if (sparse && (((address/pageBytes) % 4) != 0)) continue;
+        uint checksum = 16 + (address >> 8) + (address & 0xFF);
+        QString record = QString(":10%1").arg(address,4,16,QChar('0')) + "00";
+        for (uint n = 0; n < 16; n++)
+        {
+            uint datum = generator.generate() & 0xFF;
+            checksum += datum;
+            record += QString("%1").arg(datum,2,16,QChar('0'));
+        }
+        record += QString("%1").arg((0x100 - (checksum & 0xFF)) & 0xFF,2,16,QChar('0'));
+        out << record.toUpper() << "\n";
+        bytes += 16;
+    }
+    out << ":00000001FF\n";
+    return bytes;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Start the emulator and get its pty
+
+@param[in] emulator The emulator process.
+@param[in] path Emulator executable.
+@param[in] part Part to simulate.
+@param[in] baud Baud rate to time characters at.
+@param[in] scale Emulator time scale.
+@param[in] faults Faults to inject, empty for none.
+@param[in] seed Seed of the emulator's fault generator.
+@returns The pty name, empty if the emulator didn't start.
+*/
+
+static QString startEmulator(QProcess& emulator, const QString path,
+                             const BenchPart& part, const uint baud,
+                             const QString scale, const QString faults,
+                             const uint seed)
+{
+    QStringList arguments;
+    arguments << "-d" << part.name << "-b" << QString::number(baud)
+              << "-t" << scale;
+    if (! faults.isEmpty())
+        arguments << "-f" << faults << "-z" << QString::number(seed);
+    emulator.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    emulator.start(path,arguments);
+    if (! emulator.waitForStarted(5000)) return QString();
+    if (! emulator.waitForReadyRead(5000)) return QString();
+    return QString(emulator.readLine()).trimmed();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Upload, verify and read back an image on a fresh emulator
+
+A phase that could not be run, because the emulator or programmer didn't
+start, is returned as failed with no time. The emulator is killed at the
+deadline, so that a programmer waiting on a lost response gives up, and any
+phase that ends after the deadline is failed.
+
+@param[in] emulatorPath Emulator executable.
+@param[in] part Part to simulate.
+@param[in] baudIndex Index of the baud rate.
+@param[in] block Use block transfers.
+@param[in] imageName Hex file to upload.
+@param[in] readName Hex file to read back into.
+@param[in] span Size of the address range read back, in bytes.
+@param[in] scale Emulator time scale.
+@param[in] faults Faults to inject, empty for none.
+@param[in] seed Seed of the emulator's fault generator.
+@param[in] deadline Longest time the run may take, in seconds.
+@param[out] results Outcome of each phase.
+@returns false if the emulator could not be started.
+*/
+
+static bool runPhases(const QString emulatorPath, const BenchPart& part,
+                      const uint baudIndex, const bool block,
+                      const QString imageName, const QString readName,
+                      const uint span, const QString scale,
+                      const QString faults, const uint seed,
+                      const uint deadline, PhaseResult results[])
+{
+    for (uint phase = 0; phase < numPhases; phase++)
+    {
+        results[phase].ok = false;
+        results[phase].seconds = 0;
+        results[phase].trips = 0;
+    }
+    QProcess emulator;
+    QString portName = startEmulator(emulator,emulatorPath,part,
+                                     benchBauds[baudIndex],scale,faults,seed);
+    if (portName.isEmpty()) return false;
+    qint64 limit = (qint64)deadline*1000;
+    QElapsedTimer runTimer;
+    runTimer.start();
+    QTimer::singleShot(limit,&emulator,SLOT(kill()));
+    AvrProgrammer* programmer = new AvrProgrammer(&portName,baudIndex,showDebug);
+    if (programmer->success())
+    {
+        programmer->setParameter(READBLOCKMODE,block);
+        programmer->setParameter(WRITEBLOCKMODE,block);
+        programmer->setParameter(PASSTHROUGH,false);
+        programmer->setParameter(SKIPIDENTICAL,false);
+        for (uint phase = 0; (phase < numPhases) &&
+                             (runTimer.elapsed() < limit); phase++)
+        {
+            uint startTrips = programmer->roundTripCount();
+            QElapsedTimer timer;
+            timer.start();
+            bool error;
+            if (phase < 2)
+            {
+                programmer->setParameter(UPLOAD,phase == 0);
+                programmer->setParameter(VERIFY,phase == 1);
+                error = programmer->uploadHex(imageName);
+            }
+            else error = programmer->downloadHex(readName,0,span-1);
+            results[phase].seconds = timer.nsecsElapsed()/1e9;
+            results[phase].trips = programmer->roundTripCount() - startTrips;
+            results[phase].ok = ! error && (runTimer.elapsed() < limit);
+        }
+        if (runTimer.elapsed() >= limit)
+            fprintf(stderr,"Run with seed %u overran its %u s deadline\n",seed,deadline);
+    }
+    else fprintf(stderr,"No programmer on %s: %s\n",
+                 qPrintable(portName),qPrintable(programmer->error()));
+    delete programmer;
+    emulator.terminate();
+    emulator.waitForFinished(5000);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Benchmark Main Program */
+
+int main(int argc,char ** argv)
+{
+    QString emulatorPath = EMULATOR;
+    QStringList bauds = QString("19200,38400,57600").split(',');
+    QStringList pageSizes = QString("8,16,32,64").split(',');
+    uint span = 4096;
+    QString scale = "1";
+    QString faults;
+    uint runs = 10;
+    uint deadline = 300;
+    int c;
+    opterr = 0;
+    while ((c = getopt (argc, argv, "e:b:p:s:t:f:n:w:d")) != -1)
+    {
+        switch (c)
+        {
+        case 'e': emulatorPath = optarg; break;
+        case 'b': bauds = QString(optarg).split(','); break;
+        case 'p': pageSizes = QString(optarg).split(','); break;
+        case 's': span = QString(optarg).toUInt(); break;
+        case 't': scale = optarg; break;
+        case 'f': faults = optarg; break;
+        case 'n': runs = QString(optarg).toUInt(); break;
+        case 'w': deadline = QString(optarg).toUInt(); break;
+        case 'd': showDebug = true; break;
+        default:
+            fprintf(stderr,"Usage: %s [-e emulator] [-b bauds] [-p pagesizes] "
+                           "[-s span] [-t scale] [-f faults] [-n runs] [-w seconds] "
+                           "[-d]\n",
+                           argv[0]);
+            return 1;
+        }
+    }
+    if (faults.isEmpty()) runs = 0;
+    qInstallMessageHandler(messageHandler);
+    QCoreApplication application(argc,argv);
+    QTemporaryDir directory;
+    QString imageName = directory.path() + "/image.hex";
+    QString readName = directory.path() + "/read.hex";
+    QRandomGenerator generator(1);
+
+    printf("part,page_words,baud,mode,image,phase,seed,bytes,seconds,"
+           "bytes_per_second,round_trips,round_trips_per_page,recovery_seconds,ok\n");
+    for (uint p = 0; p < numBenchParts; p++)
+    {
+        const BenchPart& part = benchParts[p];
+        if (! pageSizes.contains(QString::number(part.pageWords))) continue;
+        uint partSpan = (span < part.flashSize) ? span : part.flashSize;
+        uint pageBytes = part.pageWords*2;
+        foreach (QString baudText, bauds)
+        {
+            uint baud = baudText.toUInt();
+            uint baudIndex = 0;
+            while ((baudIndex < numBenchBauds) && (benchBauds[baudIndex] != baud))
+                baudIndex++;
+            if (baudIndex >= numBenchBauds)
+            {
+                fprintf(stderr,"Unsupported baud rate %u\n",baud);
+                continue;
+            }
+            for (int block = 1; block >= 0; block--)
+            {
+                for (int sparse = 0; sparse <= 1; sparse++)
+                {
+                    uint bytes = writeImage(imageName,partSpan,pageBytes,sparse,
+                                              generator);
+                    uint pages = (bytes + pageBytes - 1)/pageBytes;
+                    PhaseResult baseline[numPhases];
+                    uint successes[numPhases] = {0,0,0};
+                    double recovery[numPhases] = {0,0,0};
+/* Seed 0 is the fault free run that the others are measured against */
+                    for (uint seed = 0; seed <= runs; seed++)
+                    {
+                        PhaseResult results[numPhases];
+                        if (! runPhases(emulatorPath,part,baudIndex,block,
+                                        imageName,readName,partSpan,scale,
+                                        seed ? faults : QString(),seed,
+                                        deadline,results))
+                        {
+                            fprintf(stderr,"Cannot start %s\n",qPrintable(emulatorPath));
+                            return 1;
+                        }
+                        if (seed == 0)
+                            for (uint phase = 0; phase < numPhases; phase++)
+                                baseline[phase] = results[phase];
+                        for (uint phase = 0; phase < numPhases; phase++)
+                        {
+                            PhaseResult& result = results[phase];
+                            uint phaseBytes = (phase < 2) ? bytes : partSpan;
+                            uint phasePages = (phase < 2) ? pages : partSpan/pageBytes;
+                            double extra = result.seconds - baseline[phase].seconds;
+                            if ((seed > 0) && result.ok)
+                            {
+                                successes[phase]++;
+                                recovery[phase] += extra;
+                            }
+                            printf("%s,%u,%u,%s,%s,%s,%u,%u,%.3f,%.1f,%u,%.2f,%.3f,%d\n",
+                                   part.name,part.pageWords,baud,
+                                   block ? "block" : "word",
+                                   sparse ? "sparse" : "dense",phaseName[phase],
+                                   seed,phaseBytes,result.seconds,
+                                   result.seconds > 0 ? phaseBytes/result.seconds : 0,
+                                   result.trips,(double)result.trips/phasePages,
+                                   extra,result.ok);
+                            fflush(stdout);
+                        }
+                    }
+                    for (uint phase = 0; (runs > 0) && (phase < numPhases); phase++)
+                    {
+                        fprintf(stderr,"%s %u %s %s %s: %u of %u succeeded, "
+                                       "mean recovery %.3f s\n",
+                                part.name,baud,block ? "block" : "word",
+                                sparse ? "sparse" : "dense",phaseName[phase],
+                                successes[phase],runs,successes[phase] ?
+                                recovery[phase]/successes[phase] : 0.0);
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+# Throughput benchmark of the programming engine against the emulator.
+# Built by avrserialprog-all.pro.
+
+PROJECT =       AVR Serial Programmer Benchmark
+TEMPLATE =      app
+TARGET          = avrserialprog-bench
+DEPENDPATH      += .
+QT              = core
+QT              += serialport
+
+OBJECTS_DIR     = obj-bench
+LANGUAGE        = C++
+CONFIG          += qt warn_on release console
+CONFIG          -= app_bundle
+
+# The programming engine is in the core library
+LIBS            += -L$$OUT_PWD -lavrprogcore
+PRE_TARGETDEPS  += $$OUT_PWD/libavrprogcore.a
+
+# Input
+SOURCES         += avrserialprog-bench.cpp
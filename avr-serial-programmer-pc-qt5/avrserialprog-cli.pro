@@ -0,0 +1,21 @@
+# Command line programmer, needing neither the widgets nor a display.
+# Built by avrserialprog-all.pro.
+
+PROJECT =       AVR Serial Programmer Command Line
+TEMPLATE =      app
+TARGET          = avrserialprog-cli
+DEPENDPATH      += .
+QT              = core
+QT              += serialport
+
+OBJECTS_DIR     = obj-cli
+LANGUAGE        = C++
+CONFIG          += qt warn_on release console
+CONFIG          -= app_bundle
+
+# The programming engine is in the core library
+LIBS            += -L$$OUT_PWD -lavrprogcore
+PRE_TARGETDEPS  += $$OUT_PWD/libavrprogcore.a
+
+# Input
+SOURCES         += avrserialprogcli.cpp
@@ -0,0 +1,20 @@
+# Programming engine without the GUI, linked by the window, the command line
+# program and the benchmark. Built by avrserialprog-all.pro.
+
+PROJECT =       AVR Serial Programmer Core
+TEMPLATE =      lib
+TARGET          = avrprogcore
+DEPENDPATH      += .
+QT              = core
+QT              += serialport
+
+OBJECTS_DIR     = obj-core
+MOC_DIR         = moc-core
+LANGUAGE        = C++
+CONFIG          += qt warn_on release staticlib
+
+# Input
+HEADERS         += avrprogrammer.h serialtrace.h metrics.h metricsfile.h\
+                   commandline.h
+SOURCES         += avrprogrammer.cpp serialtrace.cpp metrics.cpp metricsfile.cpp\
+                   commandline.cpp
@@ -0,0 +1,25 @@
+# Shared library with a C interface to the programming engine, for embedding
+# in test fixture software. Built by avrserialprog-all.pro.
+
+PROJECT =       AVR Serial Programmer Library
+TEMPLATE =      lib
+TARGET          = avrprog
+VERSION         = 1.0.0
+DEPENDPATH      += .
+QT              = core
+QT              += serialport
+
+OBJECTS_DIR     = obj-lib
+LANGUAGE        = C++
+CONFIG          += qt warn_on release shared hide_symbols
+DEFINES         += AVRPROG_LIBRARY
+
+# The programming engine is in the core library. Only the avrprog_ calls are
+# exported from the shared library.
+LIBS            += -L$$OUT_PWD -lavrprogcore
+PRE_TARGETDEPS  += $$OUT_PWD/libavrprogcore.a
+unix:!macx:QMAKE_LFLAGS += -Wl,--exclude-libs,ALL
+
+# Input
+HEADERS         += avrprog.h
+SOURCES         += avrproglib.cpp
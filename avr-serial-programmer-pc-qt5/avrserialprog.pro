@@ -11,6 +11,10 @@ UI_DIR          = ui
 LANGUAGE        = C++
 CONFIG          += qt warn_on release
 
+# The programming engine is in the core library
+LIBS            += -L$$OUT_PWD -lavrprogcore
+PRE_TARGETDEPS  += $$OUT_PWD/libavrprogcore.a
+
 # Input
 FORMS           += avrserialprog.ui \
                    m328Dialog.ui   m88Dialog.ui   m48Dialog.ui    m8535Dialog.ui\
@@ -24,4 +28,3 @@ SOURCES         += avrserialprogmain.cpp avrserialprog.cpp \
                    m328Dialog.cpp  m88Dialog.cpp  m48Dialog.cpp   m8535Dialog.cpp\
                    m16Dialog.cpp   t26Dialog.cpp  t261Dialog.cpp  t441Dialog.cpp\
                    t2313Dialog.cpp s2313Dialog.cpp
-
@@ -0,0 +1,45 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Command line program
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <QCoreApplication>
+#include "commandline.h"
+#include "avrprogrammer.h"
+
+//-----------------------------------------------------------------------------
+/** @brief Serial Programmer Command Line Program
+
+The same as avrserialprog -n, but built on the Qt core alone so that it starts
+quickly and runs on machines without a display. The -n option is accepted and
+ignored.
+*/
+
+int main(int argc,char ** argv)
+{
+    ProgramOptions options;
+    int status = parseOptions(argc,argv,options);
+    if (status != RUN_OK) return status;
+    QCoreApplication application(argc,argv);
+    return runCommandLine(options);
+}
@@ -54,12 +54,10 @@ Uses: Qt version 5.2.1
  ***************************************************************************/
 
 #include <QApplication>
+#include <QCoreApplication>
 #include <QMessageBox>
-#include <QDebug>
-#include <unistd.h>
 #include "avrserialprog.h"
-
-#define SERIAL_PORT "ttyUSB0"
+#include "commandline.h"
 
 //-----------------------------------------------------------------------------
 /** @brief Serial Programmer Main Program
@@ -67,121 +65,37 @@ Uses: Qt version 5.2.1
 This creates a serial port object and a programming window object. The latter
 first attempts to synchronize with the bootloader in the microcontroller. If
 this is successful, the window is opened for use.
+
+With -n the window is not used and only a QCoreApplication is made, so the run
+needs no display. The exit status and the -j and -M options are described with
+runCommandLine(). The avrserialprog-cli program does the same without linking
+the widgets at all, which starts faster.
 */
 
 int main(int argc,char ** argv)
 {
-    QString serialPort = SERIAL_PORT;
-    int c;
-    uint initialBaudrate = 5; //!< Baudrate index to start searching
-    int baudParm;
-    bool commandLineOnly = false;
-    bool loadHex = false;
-    bool readHex = false;
-    bool debug = false;
-    bool verify = false;
-    bool passThrough = false;
-    bool ok;
-    uint startAddress = 0;
-    uint endAddress = 0xFFFF;
-    QString filename;
+    ProgramOptions options;
+    int status = parseOptions(argc,argv,options);
+    if (status != RUN_OK) return status;
 
-    opterr = 0;
-    while ((c = getopt (argc, argv, "w:r:s:e:P:ndvxb:")) != -1)
+    if (options.commandLineOnly)
     {
-        switch (c)
-        {
-        case 'w':
-            loadHex = true;
-            filename = QString(optarg);
-            break;
-        case 'r':
-            readHex = true;
-            filename = QString(optarg);
-            break;
-        case 's':
-            startAddress = QString(optarg).toInt(&ok,16);
-            break;
-        case 'e':
-            endAddress = QString(optarg).toInt(&ok,16);
-            break;
-        case 'P':
-            serialPort = optarg;
-            break;
-        case 'n':
-            commandLineOnly = true;
-            break;
-        case 'd':
-            debug = true;
-            break;
-        case 'v':
-            verify = true;
-            break;
-        case 'x':
-            passThrough = true;
-            break;
-        case 'b':
-            baudParm = atoi(optarg);
-            switch (baudParm)
-            {
-            case 1200: initialBaudrate=0;break;
-            case 2400: initialBaudrate=1;break;
-            case 4800: initialBaudrate=2;break;
-            case 9600: initialBaudrate=3;break;
-            case 19200: initialBaudrate=4;break;
-            case 38400: initialBaudrate=5;break;
-            case 57600: initialBaudrate=6;break;
-            default:
-                fprintf (stderr, "Invalid Baudrate %i.\n", baudParm);
-                return false;
-            }
-            break;
-        case '?':
-            if (optopt == 'P')
-                fprintf (stderr, "Option -%c requires an argument.\n", optopt);
-            else if (isprint (optopt))
-                fprintf (stderr, "Unknown option `-%c'.\n", optopt);
-            else
-                fprintf (stderr,"Unknown option character `\\x%x'.\n",optopt);
-            default: return false;
-        }
+        QCoreApplication application(argc,argv);
+        return runCommandLine(options);
     }
 
     QApplication application(argc,argv);
-    AvrSerialProg serialProgrammer(&serialPort,initialBaudrate,commandLineOnly,debug);
-    if (! commandLineOnly)
+    AvrSerialProg serialProgrammer(&options.serialPort,options.initialBaudrate,
+                                   options.debug,0,options.traceFile);
+    serialProgrammer.setMetricsFile(options.metricsFile,options.metricsReplace);
+    if (serialProgrammer.success())
     {
-        if (serialProgrammer.success())
-        {
-            serialProgrammer.show();
-            return application.exec();
-        }
-        else
-        {
-            QMessageBox::critical(0,"Bootloader Problem",
-                  QString("Couldn't Contact Bootloader\n%1")
-                                      .arg(serialProgrammer.error()));
-             return true;
-        }
+        serialProgrammer.show();
+        return application.exec();
     }
-/* Command line only actions */
-    else
-    {
-        serialProgrammer.printDetails();
-        serialProgrammer.setParameter(PASSTHROUGH,passThrough);
-        serialProgrammer.setParameter(UPLOAD,loadHex);
-        serialProgrammer.setParameter(VERIFY,verify);
-        if (loadHex && readHex) qDebug() << "Read and write both specified";
-        else if (readHex && (!ok || (startAddress > endAddress)))
-            qDebug() << "Invalid hexadecimal address";
-        else
-        {
-            if (loadHex) serialProgrammer.uploadHex(filename);
-            if (readHex) serialProgrammer.downloadHex(filename,startAddress,endAddress);
-            qDebug() << "Leaving Normally";
-        }
-        serialProgrammer.quitProgrammer();
-    }
-    return true;
-
+    QMessageBox::critical(0,"Bootloader Problem",
+                          QString("Couldn't Contact Bootloader\n%1")
+                                  .arg(serialProgrammer.error()));
+    serialProgrammer.exportMetrics();
+    return RUN_NOPROGRAMMER;
 }
@@ -0,0 +1,212 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Command line
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <QDebug>
+#include <QByteArray>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include "avrprogrammer.h"
+#include "commandline.h"
+
+//-----------------------------------------------------------------------------
+/** @brief Read the command line options
+
+@param[in] argc Number of arguments.
+@param[in] argv Arguments.
+@param[out] options Settings found, with defaults for those not given.
+@returns RUN_OK, or RUN_USAGE if the arguments were not understood.
+*/
+
+int parseOptions(int argc, char** argv, ProgramOptions& options)
+{
+    int c;
+    int baudParm;
+    bool ok = true;
+    options.serialPort = SERIAL_PORT;
+    options.initialBaudrate = 5;
+    options.commandLineOnly = false;
+    options.loadHex = false;
+    options.readHex = false;
+    options.debug = false;
+    options.verify = false;
+    options.passThrough = false;
+    options.runTarget = false;
+    options.skipIdentical = true;
+    options.json = false;
+    options.startAddress = 0;
+    options.endAddress = 0xFFFF;
+    options.metricsReplace = false;
+
+    opterr = 0;
+    while ((c = getopt (argc, argv, "w:r:s:e:P:T:M:m:ndvxgfjb:")) != -1)
+    {
+        switch (c)
+        {
+        case 'w':
+            options.loadHex = true;
+            options.filename = QString(optarg);
+            break;
+        case 'r':
+            options.readHex = true;
+            options.filename = QString(optarg);
+            break;
+        case 's':
+            options.startAddress = QString(optarg).toInt(&ok,16);
+            break;
+        case 'e':
+            options.endAddress = QString(optarg).toInt(&ok,16);
+            break;
+        case 'P':
+            options.serialPort = optarg;
+            break;
+        case 'T':
+            options.traceFile = optarg;
+            break;
+        case 'M':
+        case 'm':
+            options.metricsFile = optarg;
+            options.metricsReplace = (c == 'm');
+            break;
+        case 'n':
+            options.commandLineOnly = true;
+            break;
+        case 'd':
+            options.debug = true;
+            break;
+        case 'v':
+            options.verify = true;
+            break;
+        case 'x':
+            options.passThrough = true;
+            break;
+        case 'g':
+            options.runTarget = true;
+            break;
+        case 'f':
+            options.skipIdentical = false;
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        case 'b':
+            baudParm = atoi(optarg);
+            switch (baudParm)
+            {
+            case 1200: options.initialBaudrate=0;break;
+            case 2400: options.initialBaudrate=1;break;
+            case 4800: options.initialBaudrate=2;break;
+            case 9600: options.initialBaudrate=3;break;
+            case 19200: options.initialBaudrate=4;break;
+            case 38400: options.initialBaudrate=5;break;
+            case 57600: options.initialBaudrate=6;break;
+            default:
+                fprintf (stderr, "Invalid Baudrate %i.\n", baudParm);
+                return RUN_USAGE;
+            }
+            break;
+        case '?':
+            if ((optopt == 'P') || (optopt == 'T') || (optopt == 'M') ||
+                (optopt == 'm'))
+                fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+            else if (isprint (optopt))
+                fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+            else
+                fprintf (stderr,"Unknown option character `\\x%x'.\n",optopt);
+            default: return RUN_USAGE;
+        }
+    }
+    if (options.loadHex && options.readHex)
+    {
+        fprintf (stderr, "Read and write both specified.\n");
+        return RUN_USAGE;
+    }
+    if (options.readHex && (!ok || (options.startAddress > options.endAddress)))
+    {
+        fprintf (stderr, "Invalid hexadecimal address.\n");
+        return RUN_USAGE;
+    }
+    return RUN_OK;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Program or read the target without a window
+
+Only the Qt core is needed, so that this can run from scripts on machines
+without a display. A QCoreApplication must exist before this is called.
+
+The exit status tells how the run went, as given by the outcome enumeration:
+0 success, 1 bad arguments, 2 no programmer, 3 file error, 4 link failure,
+5 verify failure. With -j a JSON description of the device and the run is
+written to stdout, the log going to stderr as usual.
+
+With -M file the metrics of each session are added to a Prometheus text file,
+for the node exporter's textfile collector. With -m file the file is replaced
+with the metrics of this session alone.
+
+@param[in] options Settings from the command line.
+@returns the outcome of the run, to be used as the exit status.
+*/
+
+int runCommandLine(const ProgramOptions& options)
+{
+    QString serialPort = options.serialPort;
+    AvrProgrammer serialProgrammer(&serialPort,options.initialBaudrate,
+                                   options.debug,options.traceFile);
+    serialProgrammer.setMetricsFile(options.metricsFile,options.metricsReplace);
+    if (serialProgrammer.success())
+    {
+        serialProgrammer.printDetails();
+// Nothing is done if the target can't be run as asked, but the exit is as usual
+        bool runnable = (! options.runTarget) || serialProgrammer.canRunTarget();
+        if (! runnable)
+        {
+            fprintf (stderr, "The programmer can't run the target (-g).\n");
+            serialProgrammer.refuseRun("The programmer can't run the target (-g)");
+        }
+        serialProgrammer.setParameter(PASSTHROUGH,options.passThrough);
+        serialProgrammer.setParameter(RUNTARGET,options.runTarget && runnable);
+        serialProgrammer.setParameter(UPLOAD,options.loadHex);
+        serialProgrammer.setParameter(VERIFY,options.verify);
+        serialProgrammer.setParameter(SKIPIDENTICAL,options.skipIdentical);
+        if (runnable && options.loadHex) serialProgrammer.uploadHex(options.filename);
+        if (runnable && options.readHex)
+            serialProgrammer.downloadHex(options.filename,options.startAddress,
+                                         options.endAddress);
+        serialProgrammer.printMetrics();
+        serialProgrammer.quitProgrammer();
+        if (serialProgrammer.result() == RUN_OK) qDebug() << "Leaving Normally";
+    }
+    else qDebug() << "Couldn't Contact Bootloader" << serialProgrammer.error();
+    serialProgrammer.exportMetrics();
+    if (options.json)
+    {
+        QByteArray report = serialProgrammer.jsonReport(options.filename);
+        fwrite(report.constData(),1,report.size(),stdout);
+        fflush(stdout);
+    }
+    return serialProgrammer.result();
+}
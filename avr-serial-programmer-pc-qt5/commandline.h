@@ -0,0 +1,58 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Command line
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <QString>
+
+#define SERIAL_PORT "ttyUSB0"
+
+/** @brief Settings given on the command line */
+struct ProgramOptions
+{
+    QString serialPort;             //!< Port the programmer is on
+    uint initialBaudrate;           //!< Baudrate index to start searching
+    bool commandLineOnly;           //!< -n, no window
+    bool loadHex;                   //!< -w, upload the file
+    bool readHex;                   //!< -r, read the target to the file
+    bool debug;
+    bool verify;
+    bool passThrough;
+    bool runTarget;
+    bool skipIdentical;             //!< Unless -f, don't reprogram the same image
+    bool json;                      //!< -j, JSON description to stdout
+    uint startAddress;
+    uint endAddress;
+    QString filename;
+    QString traceFile;
+    QString metricsFile;            //!< Prometheus text file, if any
+    bool metricsReplace;            //!< -m rather than -M
+};
+
+int parseOptions(int argc, char** argv, ProgramOptions& options);
+int runCommandLine(const ProgramOptions& options);
+
+#endif
@@ -49,7 +49,7 @@ ATMega328
 @param parent Parent widget.
 */
 
-M328Dialog::M328Dialog(QSerialPort* p, QWidget* parent) : QDialog(parent)
+M328Dialog::M328Dialog(TracedSerialPort* p, QWidget* parent) : QDialog(parent)
 {
     port = p;
 // Build the User Interface display from the Ui class in ui_mainwindowform.h
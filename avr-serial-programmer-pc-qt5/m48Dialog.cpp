@@ -45,7 +45,7 @@ programming. This applies to the ATMega48.
 @param parent Parent widget.
 */
 
-M48Dialog::M48Dialog(QSerialPort* p, QWidget* parent) : QDialog(parent)
+M48Dialog::M48Dialog(TracedSerialPort* p, QWidget* parent) : QDialog(parent)
 {
     port = p;
 // Build the User Interface display from the Ui class in ui_mainwindowform.h
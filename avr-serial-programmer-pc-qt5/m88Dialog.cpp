@@ -46,7 +46,7 @@ ATMega88, ATMega168
 @param parent Parent widget.
 */
 
-M88Dialog::M88Dialog(QSerialPort* p, QWidget* parent) : QDialog(parent)
+M88Dialog::M88Dialog(TracedSerialPort* p, QWidget* parent) : QDialog(parent)
 {
     port = p;
 // Build the User Interface display from the Ui class in ui_mainwindowform.h
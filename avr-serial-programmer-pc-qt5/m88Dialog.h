@@ -29,7 +29,7 @@ Title:    Atmel Microcontroller Serial Port FLASH loader. M88 Lock/Fuse bits
 #define _TTY_POSIX_         // Need to tell qextserialport we are in POSIX
 
 #include "ui/ui_m88Dialog.h"
-#include <QSerialPort>
+#include "serialtrace.h"
 #include <QDialog>
 #include <QCloseEvent>
 
@@ -43,7 +43,7 @@ class M88Dialog : public QDialog
 {
     Q_OBJECT
 public:
-    M88Dialog(QSerialPort*, QWidget* parent = 0);
+    M88Dialog(TracedSerialPort*, QWidget* parent = 0);
     ~M88Dialog();
     void setDefaults(uchar l, uchar e, uchar h, uchar f);
 private slots:
@@ -54,7 +54,7 @@ private slots:
     void on_highFuseWriteButton_clicked();
     void on_fuseWriteButton_clicked();
 private:
-    QSerialPort* port;           //!< Serial port object pointer
+    TracedSerialPort* port;      //!< Serial port object pointer
     uchar lockBitsOriginal;
     uchar extFuseBitsOriginal;
     uchar highFuseBitsOriginal;
@@ -0,0 +1,303 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Run metrics
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <algorithm>
+#include "metrics.h"
+
+//-----------------------------------------------------------------------------
+/** Constructor
+
+@param[in] serialPort Port whose traffic is counted.
+*/
+
+ProgrammerMetrics::ProgrammerMetrics(const TracedSerialPort* serialPort)
+{
+    port = serialPort;
+    timer.start();
+    clear();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Forget everything, ready for a new run
+
+This is only to be called between runs, as any phase still running is lost.
+*/
+
+void ProgrammerMetrics::clear()
+{
+    phaseList.clear();
+    openPhases = 0;
+    cleared = timer.nsecsElapsed();
+    sentBase = port->bytesSent();
+    receivedBase = port->bytesReceived();
+    roundTripCount = 0;
+    timeoutCount = 0;
+    retryCount = 0;
+    resyncCount = 0;
+    mismatchCount = 0;
+    latencies.clear();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Mark the start of a phase
+
+Phases may be nested, such as synchronisation within initialisation.
+
+@param[in] name Phase name.
+@returns the phase, to be given to endPhase().
+*/
+
+int ProgrammerMetrics::startPhase(const QString name)
+{
+    MetricsPhase phase;
+    phase.name = name;
+    phase.depth = openPhases++;
+    phase.start = timer.nsecsElapsed();
+    phase.duration = -1;
+// The counts at the start are held here until the phase ends
+    phase.bytesSent = port->bytesSent();
+    phase.bytesReceived = port->bytesReceived();
+    phase.roundTrips = roundTripCount;
+    phaseList.append(phase);
+    return phaseList.size() - 1;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Mark the end of a phase
+
+@param[in] phase Phase returned by startPhase().
+*/
+
+void ProgrammerMetrics::endPhase(const int phase)
+{
+    if ((phase < 0) || (phase >= phaseList.size())) return;
+    MetricsPhase& entry = phaseList[phase];
+    if (entry.duration >= 0) return;
+    entry.duration = timer.nsecsElapsed() - entry.start;
+    entry.bytesSent = port->bytesSent() - entry.bytesSent;
+    entry.bytesReceived = port->bytesReceived() - entry.bytesReceived;
+    entry.roundTrips = roundTripCount - entry.roundTrips;
+    if (openPhases > 0) openPhases--;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Note the end of a wait for a response
+
+@param[in] command Command that was waiting.
+@param[in] latency Time from the last byte sent to the response (ns).
+@param[in] received false if the wait timed out.
+*/
+
+void ProgrammerMetrics::response(const char command, const qint64 latency,
+                                 const bool received)
+{
+    roundTripCount++;
+    if (! received) timeoutCount++;
+    else latencies[command].append(latency);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Count something sent again after a failure */
+
+void ProgrammerMetrics::countRetry()
+{
+    retryCount++;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Count a resynchronisation of the programmer */
+
+void ProgrammerMetrics::countResync()
+{
+    resyncCount++;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Count pages that failed verification
+
+@param[in] pages Number of pages.
+*/
+
+void ProgrammerMetrics::countMismatch(const uint pages)
+{
+    mismatchCount += pages;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Phases in the order they started */
+
+const QList<MetricsPhase>& ProgrammerMetrics::phases() const
+{
+    return phaseList;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Time since the metrics were cleared (ns) */
+
+qint64 ProgrammerMetrics::elapsed() const
+{
+    return timer.nsecsElapsed() - cleared;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Bytes sent since the metrics were cleared */
+
+quint64 ProgrammerMetrics::bytesSent() const
+{
+    return port->bytesSent() - sentBase;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Bytes received since the metrics were cleared */
+
+quint64 ProgrammerMetrics::bytesReceived() const
+{
+    return port->bytesReceived() - receivedBase;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Responses waited for, including those that timed out */
+
+uint ProgrammerMetrics::roundTrips() const
+{
+    return roundTripCount;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Waits for a response that timed out */
+
+uint ProgrammerMetrics::timeouts() const
+{
+    return timeoutCount;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Pages, frames and addresses sent again after a failure */
+
+uint ProgrammerMetrics::retries() const
+{
+    return retryCount;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Resynchronisations of the programmer */
+
+uint ProgrammerMetrics::resyncs() const
+{
+    return resyncCount;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Pages that failed verification, counting each attempt */
+
+uint ProgrammerMetrics::mismatches() const
+{
+    return mismatchCount;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Commands that have had a response */
+
+QList<char> ProgrammerMetrics::commands() const
+{
+    return latencies.keys();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Number of responses to a command */
+
+uint ProgrammerMetrics::responses(const char command) const
+{
+    return latencies.value(command).size();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Latency percentile of a command
+
+The nearest rank is taken, so the 100th percentile is the largest.
+
+@param[in] command Command.
+@param[in] percent Percentile, 0 to 100.
+@returns the latency (ns), 0 if the command had no responses.
+*/
+
+qint64 ProgrammerMetrics::latency(const char command, const uint percent) const
+{
+    QVector<qint64> sorted = latencies.value(command);
+    if (sorted.isEmpty()) return 0;
+    std::sort(sorted.begin(),sorted.end());
+    int rank = (percent*sorted.size() + 99)/100;
+    if (rank < 1) rank = 1;
+    if (rank > sorted.size()) rank = sorted.size();
+    return sorted[rank - 1];
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Readable summary of the metrics
+
+@returns lines of text, in a layout suited to a fixed width font.
+*/
+
+QString ProgrammerMetrics::report() const
+{
+    QString text;
+    text += QString("%1%2 %3 %4 %5\n").arg("Phase",-12).arg("ms",9)
+                .arg("Sent",8).arg("Received",8).arg("Round trips",12);
+    for (int n = 0; n < phaseList.size(); n++)
+    {
+        const MetricsPhase& phase = phaseList[n];
+        if (phase.duration < 0) continue;
+        text += QString("%1%2 %3 %4 %5\n")
+                    .arg(QString(phase.depth*2,' ')+phase.name,-12)
+                    .arg(phase.duration/1e6,9,'f',1)
+                    .arg(phase.bytesSent,8)
+                    .arg(phase.bytesReceived,8)
+                    .arg(phase.roundTrips,12);
+    }
+    text += QString("Bytes sent %1, received %2\n")
+                .arg(bytesSent()).arg(bytesReceived());
+    text += QString("Round trips %1, timeouts %2\n")
+                .arg(roundTripCount).arg(timeoutCount);
+    text += QString("Retries %1, resyncs %2, verify mismatches %3\n")
+                .arg(retryCount).arg(resyncCount).arg(mismatchCount);
+    if (latencies.isEmpty()) return text;
+    text += QString("%1 %2 %3 %4 %5 %6\n").arg("Command",-7).arg("Count",6)
+                .arg("Median ms",11).arg("90% ms",8).arg("99% ms",8).arg("Max ms",8);
+    QList<char> list = commands();
+    for (int n = 0; n < list.size(); n++)
+    {
+        char command = list[n];
+        QString name = ((command > ' ') && (command < 0x7F)) ? QString(command)
+                     : QString("%1").arg((uchar)command,2,16,QLatin1Char('0'));
+        text += QString("%1 %2 %3 %4 %5 %6\n")
+                    .arg(name,-7)
+                    .arg(responses(command),6)
+                    .arg(latency(command,50)/1e6,11,'f',2)
+                    .arg(latency(command,90)/1e6,8,'f',2)
+                    .arg(latency(command,99)/1e6,8,'f',2)
+                    .arg(latency(command,100)/1e6,8,'f',2);
+    }
+    return text;
+}
@@ -0,0 +1,98 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Run metrics
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef PROGRAMMER_METRICS_H
+#define PROGRAMMER_METRICS_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QVector>
+#include <QString>
+#include "serialtrace.h"
+
+/** @brief Time and traffic of one phase of a run */
+struct MetricsPhase
+{
+    QString name;                   //!< Phase name, such as "Erase"
+    uint depth;                     //!< Number of phases it is nested in
+    qint64 start;                   //!< Time it started (ns)
+    qint64 duration;                //!< Time it took (ns), -1 while running
+    quint64 bytesSent;              //!< Bytes sent during the phase
+    quint64 bytesReceived;          //!< Bytes received during the phase
+    uint roundTrips;                //!< Responses waited for during the phase
+};
+
+//-----------------------------------------------------------------------------
+/** @brief Where the time went in a programming run.
+
+The programmer marks the start and end of each phase of a run, and counts the
+retries, resynchronisations and verify mismatches as they happen. Each wait for
+a response is noted with the command that was waiting and the time from the
+last byte sent to the response, so that latency percentiles can be given per
+command. Byte counts are taken from the port.
+*/
+
+class ProgrammerMetrics
+{
+public:
+    ProgrammerMetrics(const TracedSerialPort* serialPort);
+    void clear();
+    int startPhase(const QString name);
+    void endPhase(const int phase);
+    void response(const char command, const qint64 latency, const bool received);
+    void countRetry();
+    void countResync();
+    void countMismatch(const uint pages = 1);
+    const QList<MetricsPhase>& phases() const;
+    qint64 elapsed() const;
+    quint64 bytesSent() const;
+    quint64 bytesReceived() const;
+    uint roundTrips() const;
+    uint timeouts() const;
+    uint retries() const;
+    uint resyncs() const;
+    uint mismatches() const;
+    QList<char> commands() const;
+    uint responses(const char command) const;
+    qint64 latency(const char command, const uint percent) const;
+    QString report() const;
+private:
+    const TracedSerialPort* port;   //!< Port whose bytes are counted
+    QElapsedTimer timer;            //!< Time base of the phases
+    QList<MetricsPhase> phaseList;  //!< Phases in the order they started
+    uint openPhases;                //!< Phases started and not yet ended
+    qint64 cleared;                 //!< Time the metrics were cleared (ns)
+    quint64 sentBase;               //!< Port counts when last cleared
+    quint64 receivedBase;
+    uint roundTripCount;
+    uint timeoutCount;              //!< Waits that ended without a response
+    uint retryCount;                //!< Pages, frames and addresses sent again
+    uint resyncCount;
+    uint mismatchCount;             //!< Pages that failed verification
+    QMap<char,QVector<qint64> > latencies;  //!< Response times by command (ns)
+};
+
+#endif
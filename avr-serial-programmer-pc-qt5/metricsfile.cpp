@@ -0,0 +1,198 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Metrics text file
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+#include "metricsfile.h"
+
+// Longest wait for another session to finish with the file (ms)
+#define LOCK_WAIT 5000
+
+//-----------------------------------------------------------------------------
+/** Constructor
+
+@param[in] name File name, which should end in .prom for the collector.
+*/
+
+MetricsFile::MetricsFile(const QString name) : lockFile(name + ".lock")
+{
+    fileName = name;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Lock the file against other sessions
+
+The lock is left in a file beside it, which the collector ignores as it doesn't
+end in .prom. A lock left by a session that died is taken over once stale.
+
+@returns false if another session held the file for too long.
+*/
+
+bool MetricsFile::lock()
+{
+    if (lockFile.isLocked()) return true;
+    return lockFile.tryLock(LOCK_WAIT);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Load the samples already in the file
+
+Comments are skipped, as the families are described again before saving, and
+so are lines that can't be understood.
+
+@returns false if the file couldn't be locked, or exists but could not be read.
+*/
+
+bool MetricsFile::load()
+{
+    if (! lock()) return false;
+    QFile file(fileName);
+    if (! file.exists()) return true;
+    if (! file.open(QIODevice::ReadOnly)) return false;
+    QTextStream stream(&file);
+    while (! stream.atEnd())
+    {
+        QString line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        int space = line.lastIndexOf(' ');
+        if (space <= 0) continue;
+        bool ok;
+        double value = line.mid(space+1).toDouble(&ok);
+        if (ok) set(line.left(space).trimmed(),value);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Describe a metric family
+
+@param[in] family Family name. For a histogram, the name without the suffixes.
+@param[in] type "counter", "gauge" or "histogram".
+@param[in] help Description of the metric.
+*/
+
+void MetricsFile::describe(const QString family, const QString type,
+                           const QString help)
+{
+    if (! families.contains(family)) families.append(family);
+    types[family] = type;
+    helps[family] = help;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Add to a counter, starting it at zero if it is new
+
+@param[in] sample Sample name with any labels.
+@param[in] value Amount to add.
+*/
+
+void MetricsFile::add(const QString sample, const double value)
+{
+    if (! values.contains(sample)) samples.append(sample);
+    values[sample] += value;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Set a gauge
+
+@param[in] sample Sample name with any labels.
+@param[in] value New value.
+*/
+
+void MetricsFile::set(const QString sample, const double value)
+{
+    if (! values.contains(sample)) samples.append(sample);
+    values[sample] = value;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Add an observation to a histogram
+
+The buckets are cumulative, each counting the observations no larger than its
+bound, with a last bucket for everything.
+
+@param[in] family Histogram name.
+@param[in] bounds Upper bounds of the buckets, in increasing order.
+@param[in] value Observation.
+*/
+
+void MetricsFile::observe(const QString family, const QList<double>& bounds,
+                          const double value)
+{
+    for (int n = 0; n < bounds.size(); n++)
+        add(QString("%1_bucket{le=\"%2\"}").arg(family)
+                .arg(QString::number(bounds[n],'g',15)),
+            (value <= bounds[n]) ? 1 : 0);
+    add(family + "_bucket{le=\"+Inf\"}",1);
+    add(family + "_sum",value);
+    add(family + "_count",1);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Replace the file with the described families
+
+The samples of each family follow its description, in the order they were
+first seen. The lock is released once the file is written.
+
+@returns false if the file could not be locked or written.
+*/
+
+bool MetricsFile::save()
+{
+    if (! lock()) return false;
+    QSaveFile file(fileName);
+    if (! file.open(QIODevice::WriteOnly))
+    {
+        lockFile.unlock();
+        return false;
+    }
+    QTextStream out(&file);
+    for (int n = 0; n < families.size(); n++)
+    {
+        QString family = families[n];
+        out << "# HELP " << family << " " << helps[family] << "\n";
+        out << "# TYPE " << family << " " << types[family] << "\n";
+        for (int m = 0; m < samples.size(); m++)
+        {
+            QString name = samples[m].section('{',0,0);
+            if ((name == family) || ((types[family] == "histogram") &&
+                ((name == family + "_bucket") || (name == family + "_sum") ||
+                 (name == family + "_count"))))
+                out << samples[m] << " "
+                    << QString::number(values[samples[m]],'g',15) << "\n";
+        }
+    }
+    out.flush();
+    if (out.status() != QTextStream::Ok)
+    {
+        file.cancelWriting();
+        lockFile.unlock();
+        return false;
+    }
+    bool saved = file.commit();
+    lockFile.unlock();
+    return saved;
+}
@@ -0,0 +1,72 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Metrics text file
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef METRICS_FILE_H
+#define METRICS_FILE_H
+
+#include <QList>
+#include <QLockFile>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+//-----------------------------------------------------------------------------
+/** @brief Metrics in the Prometheus text format, kept in a file.
+
+This is for the textfile collector of the Prometheus node exporter. The samples
+already in the file are loaded first, so that counters and histograms carry on
+from one session to the next. The file is replaced as a whole when saved, so
+that the collector never sees it half written. It is locked from the load until
+the save, so that sessions sharing the file don't lose each other's counts.
+
+Samples are named in full with their labels, such as
+avrprog_sessions_total{result="ok"}. Each metric family must be described
+before it is saved, and samples from the file of families no longer described
+are dropped.
+*/
+
+class MetricsFile
+{
+public:
+    MetricsFile(const QString name);
+    bool load();
+    void describe(const QString family, const QString type, const QString help);
+    void add(const QString sample, const double value);
+    void set(const QString sample, const double value);
+    void observe(const QString family, const QList<double>& bounds,
+                 const double value);
+    bool save();
+private:
+    bool lock();
+    QString fileName;               //!< File to load and save
+    QLockFile lockFile;             //!< Held from the load through the save
+    QStringList families;           //!< Metric families in the order described
+    QMap<QString,QString> types;    //!< Family type by name
+    QMap<QString,QString> helps;    //!< Family help text by name
+    QStringList samples;            //!< Sample names in the order first seen
+    QMap<QString,double> values;    //!< Sample values by name
+};
+
+#endif
@@ -0,0 +1,259 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Serial link trace
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <QFile>
+#include <QDataStream>
+#include "serialtrace.h"
+
+//-----------------------------------------------------------------------------
+/** Constructor
+
+The whole buffer is allocated here so that recording never allocates.
+
+@param[in] capacity Number of records held before the oldest are overwritten.
+*/
+
+SerialTrace::SerialTrace(const uint capacity)
+{
+    records.resize(capacity > 0 ? capacity : 1);
+    next = 0;
+    count = 0;
+    timer.start();
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Record bytes sent or received
+
+All the bytes are given the same time.
+
+@param[in] kind TRACE_TX or TRACE_RX.
+@param[in] data The bytes.
+@param[in] length Number of bytes.
+*/
+
+void SerialTrace::record(const quint8 kind, const char* data, const qint64 length)
+{
+    quint64 now = timer.nsecsElapsed();
+    for (qint64 n = 0; n < length; n++)
+    {
+        TraceRecord& entry = records[next];
+        entry.time = now;
+        entry.value = (uchar)data[n];
+        entry.kind = kind;
+        if (++next >= (uint)records.size()) next = 0;
+    }
+    count += length;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Record an event with a value, such as a baud rate change
+
+@param[in] kind Kind of record.
+@param[in] value Value of the event.
+*/
+
+void SerialTrace::recordValue(const quint8 kind, const quint32 value)
+{
+    TraceRecord& entry = records[next];
+    entry.time = timer.nsecsElapsed();
+    entry.value = value;
+    entry.kind = kind;
+    if (++next >= (uint)records.size()) next = 0;
+    count++;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Write the trace to a file
+
+@param[in] fileName File to write.
+@returns false if the file could not be written.
+*/
+
+bool SerialTrace::save(const QString fileName)
+{
+    QFile file(fileName);
+    if (! file.open(QIODevice::WriteOnly)) return false;
+    uint size = records.size();
+    quint64 held = (count < size) ? count : size;
+    uint first = (count < size) ? 0 : next;
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(TRACE_MAGIC,8);
+    out << (quint32)TRACE_VERSION << (quint32)0 << held << (count - held);
+    for (quint64 n = 0; n < held; n++)
+    {
+        const TraceRecord& entry = records[(first + n) % size];
+        out << entry.time << entry.value << entry.kind
+            << (quint8)0 << (quint8)0 << (quint8)0;
+    }
+    return (out.status() == QDataStream::Ok);
+}
+
+//-----------------------------------------------------------------------------
+/** Constructor
+
+@param[in] name Serial port name.
+*/
+
+TracedSerialPort::TracedSerialPort(const QString& name) : QSerialPort(name)
+{
+    trace = 0;
+    seen = 0;
+    sent = 0;
+    received = 0;
+    pending = 0;
+    awaiting = false;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Start recording in a trace
+
+@param[in] serialTrace The trace, or null to stop recording.
+*/
+
+void TracedSerialPort::setTrace(SerialTrace* serialTrace)
+{
+    if (trace) disconnect(this,SIGNAL(readyRead()),this,SLOT(noteArrivals()));
+    trace = serialTrace;
+    seen = QSerialPort::bytesAvailable();
+    if (trace) connect(this,SIGNAL(readyRead()),this,SLOT(noteArrivals()));
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read bytes, keeping count of the ones recorded */
+
+qint64 TracedSerialPort::read(char* data, qint64 maxSize)
+{
+    if (trace) noteArrivals();
+    qint64 length = QSerialPort::read(data,maxSize);
+    if (length > 0)
+    {
+        if (trace) seen -= length;
+        received += length;
+        awaiting = false;
+    }
+    return length;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Read all waiting bytes, keeping count of the ones recorded */
+
+QByteArray TracedSerialPort::readAll()
+{
+    if (trace) noteArrivals();
+    QByteArray data = QSerialPort::readAll();
+    seen -= data.size();
+    if (seen < 0) seen = 0;
+    received += data.size();
+    if (! data.isEmpty()) awaiting = false;
+    return data;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Discard waiting bytes, after recording any not yet seen */
+
+bool TracedSerialPort::clear(Directions directions)
+{
+    if (trace) noteArrivals();
+    bool ok = QSerialPort::clear(directions);
+    if (directions & Input) seen = 0;
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Change the baud rate, noting it in the trace */
+
+bool TracedSerialPort::setBaudRate(qint32 baudRate, Directions directions)
+{
+    if (trace) trace->recordValue(TRACE_BAUD,baudRate);
+    return QSerialPort::setBaudRate(baudRate,directions);
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Bytes written since the port was made */
+
+quint64 TracedSerialPort::bytesSent() const
+{
+    return sent;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Bytes read since the port was made */
+
+quint64 TracedSerialPort::bytesReceived() const
+{
+    return received;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Command waiting for a response
+
+@returns the first byte written since the last read.
+*/
+
+char TracedSerialPort::command() const
+{
+    return pending;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Time since the last write (ns), 0 if nothing has been written */
+
+qint64 TracedSerialPort::sinceWrite() const
+{
+    return lastWrite.isValid() ? lastWrite.nsecsElapsed() : 0;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Record and count bytes as they are written */
+
+qint64 TracedSerialPort::writeData(const char* data, qint64 length)
+{
+    qint64 written = QSerialPort::writeData(data,length);
+    if (written <= 0) return written;
+    if (trace) trace->record(TRACE_TX,data,written);
+    if (! awaiting) pending = data[0];
+    awaiting = true;
+    sent += written;
+    lastWrite.start();
+    return written;
+}
+
+//-----------------------------------------------------------------------------
+/** @brief Record the bytes that have arrived since last time
+
+The new bytes are at the end of those waiting, beyond the ones already seen.
+*/
+
+void TracedSerialPort::noteArrivals()
+{
+    qint64 waiting = QSerialPort::bytesAvailable();
+    if (waiting > seen)
+    {
+        QByteArray data = peek(waiting);
+        trace->record(TRACE_RX,data.constData()+seen,data.size()-seen);
+        seen = data.size();
+    }
+}
@@ -0,0 +1,121 @@
+/*
+Title:    Atmel Microcontroller Serial Port FLASH loader. Serial link trace
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published bythe Free Software Foundation; either version 2 of the      *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer if not, write to the                      *
+ *   Free Software Foundation, Inc.,                                        *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef SERIAL_TRACE_H
+#define SERIAL_TRACE_H
+
+#include <QSerialPort>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QString>
+
+/* Trace file layout. All fields are little endian. The 32 byte header is the
+8 character magic string, the version (32 bits), a reserved word (32 bits), the
+record count (64 bits) and the number of records lost when the buffer wrapped
+(64 bits). The records follow, oldest first. Each is the time (64 bits), the
+value (32 bits), the kind (8 bits) and three bytes of padding. */
+#define TRACE_MAGIC     "AVRTRACE"
+#define TRACE_VERSION   1
+#define TRACE_RECORDS   (1 << 20)   //!< Default ring buffer size in records
+
+/* Kinds of trace record */
+#define TRACE_TX        0           //!< Byte sent to the programmer
+#define TRACE_RX        1           //!< Byte received from the programmer
+#define TRACE_BAUD      2           //!< Baud rate changed, value is the rate
+
+/** @brief One event on the serial link, 16 bytes in the file */
+struct TraceRecord
+{
+    quint64 time;                   //!< Monotonic time since the start (ns)
+    quint32 value;                  //!< Byte, or baud rate
+    quint8 kind;                    //!< TRACE_TX, TRACE_RX or TRACE_BAUD
+};
+
+//-----------------------------------------------------------------------------
+/** @brief Timestamped record of the bytes on a serial link.
+
+The records are kept in a ring buffer allocated when the trace starts, so that
+recording a byte costs a timer read and a store. Nothing is written out until
+save() is called at the end of the session. If the buffer fills, the oldest
+records are overwritten and counted as lost.
+*/
+
+class SerialTrace
+{
+public:
+    SerialTrace(const uint capacity = TRACE_RECORDS);
+    void record(const quint8 kind, const char* data, const qint64 length);
+    void recordValue(const quint8 kind, const quint32 value);
+    bool save(const QString fileName);
+private:
+    QVector<TraceRecord> records;   //!< Ring buffer
+    uint next;                      //!< Where the next record goes
+    quint64 count;                  //!< Records made, including those lost
+    QElapsedTimer timer;            //!< Monotonic time base
+};
+
+//-----------------------------------------------------------------------------
+/** @brief Serial port that can record its traffic in a SerialTrace.
+
+Sent bytes are recorded as they are written. Received bytes are recorded when
+they arrive, on readyRead, rather than when the programmer gets round to
+reading them. To know which of the waiting bytes are new, the reads must go
+through this class, so it stands in for QSerialPort everywhere the port is
+used. With no trace set, nothing is recorded.
+
+Whether or not there is a trace, the bytes sent and received are counted, and
+the command waiting for a response and the time of the last write are kept, for
+the run metrics.
+*/
+
+class TracedSerialPort : public QSerialPort
+{
+    Q_OBJECT
+public:
+    TracedSerialPort(const QString& name);
+    void setTrace(SerialTrace* serialTrace);
+    qint64 read(char* data, qint64 maxSize);
+    QByteArray readAll();
+    bool clear(Directions directions = AllDirections);
+    bool setBaudRate(qint32 baudRate, Directions directions = AllDirections);
+    quint64 bytesSent() const;
+    quint64 bytesReceived() const;
+    char command() const;
+    qint64 sinceWrite() const;
+protected:
+    qint64 writeData(const char* data, qint64 length);
+private slots:
+    void noteArrivals();
+private:
+    SerialTrace* trace;             //!< Trace to record in, null if none
+    qint64 seen;                    //!< Waiting bytes already recorded
+    quint64 sent;                   //!< Bytes written since the port was made
+    quint64 received;               //!< Bytes read since the port was made
+    char pending;                   //!< First byte written since the last read
+    bool awaiting;                  //!< Something written since the last read
+    QElapsedTimer lastWrite;        //!< Time since the last write
+};
+
+#endif
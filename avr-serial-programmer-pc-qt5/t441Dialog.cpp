@@ -45,7 +45,7 @@ programming. This applies to the ATTiny441/841.
 @param parent Parent widget.
 */
 
-T441Dialog::T441Dialog(QSerialPort* p, QWidget* parent) : QDialog(parent)
+T441Dialog::T441Dialog(TracedSerialPort* p, QWidget* parent) : QDialog(parent)
 {
     port = p;
 // Build the User Interface display from the Ui class in ui_mainwindowform.h
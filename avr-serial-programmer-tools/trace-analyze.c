@@ -0,0 +1,477 @@
+/**
+@file trace-analyze.c
+@brief Where the time went in a recorded programming session
+
+@details The bytes sent in a trace recorded by the PC program (-T) are decoded
+as AVR109 commands, with the extensions of the 4313 firmware, and the bytes
+received between one command and the next are taken as its reply. From this
+the session time is shared out between the commands, grouped into phases, and
+the gaps in which the PC was working out what to send next.
+
+For each command with a reply, the round trip is the time from the last byte
+sent to the first byte back. Part of that is the bytes still on the wire at the
+baud rate. The rest, beyond the wire time, is the time of the serial adaptor
+and the programmer. Commands that need nothing of the target (such as 'a' and
+'S') show what the adaptor alone costs, and what a command takes beyond that
+is the firmware and its SPI traffic.
+
+    trace-analyze [-v] trace-file
+
+- -v  also list every command with its times
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tracefile.h"
+
+#define ESC         0x1B
+#define IDLE_CHAR   0xDD            // Sent by the PC when looking for the programmer
+#define BUCKETS     16              // Round trip histogram, doubling from
+#define BUCKET_BASE 64000ULL        // 64us up
+
+/** @brief Phases, each a group of commands */
+enum Phase {SETUP,ADDRESS,ERASE,WRITE,READ,FUSES,RESYNC,OTHER,PHASES};
+const char *phaseName[PHASES] =
+    {"Setup","Address","Erase","Write","Read","Lock/fuse","Resync","Other"};
+
+/** @brief One command as decoded, with its reply */
+struct Command
+{
+    uint8_t code;
+    uint64_t start;                 // First byte sent
+    uint64_t lastTx;                // Last byte sent, as written by the PC
+    uint64_t txWire;                // Last byte sent off the wire
+    uint64_t wire;                  // Character time at the baud rate
+    uint64_t firstRx;               // First byte of the reply
+    uint64_t end;                   // Last byte either way
+    uint32_t txBytes;
+    uint32_t rxBytes;
+};
+
+/** @brief Totals for one command character */
+struct CommandStats
+{
+    uint32_t count;
+    uint64_t time;                  // From first byte sent to last byte either way
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    uint32_t replies;               // Commands with a round trip
+    uint64_t beyondWire;            // Total round trip time beyond the wire
+    uint64_t leastBeyond;
+};
+
+/** @brief Round trip of one command, kept for the percentiles */
+struct RoundTrip
+{
+    uint8_t code;
+    uint64_t time;
+};
+
+static struct CommandStats stats[256];
+static uint64_t phaseTime[PHASES];
+static uint32_t phaseCount[PHASES];
+static uint64_t gapTime;            // Between the end of one command and the next
+static uint32_t histogram[BUCKETS];
+static struct RoundTrip *trips;
+static uint32_t tripCount;
+static uint32_t tripSpace;
+static int verbose;
+
+static enum Phase phaseOf(const uint8_t code);
+static uint32_t fixedArguments(const uint8_t code);
+static uint32_t headerLength(const uint8_t code);
+static void endCommand(struct Command *command, const uint64_t next);
+static void addTrip(const uint8_t code, const uint64_t time);
+static int compareTrips(const void *a, const void *b);
+static uint64_t busyTime(const struct Trace *trace, uint64_t *txBusy,
+                         uint64_t *rxBusy);
+static void report(const struct Trace *trace, const char *fileName);
+static const char *printable(const uint8_t code);
+
+/*****************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc,argv,"v")) != -1)
+    {
+        switch (c)
+        {
+            case 'v': verbose = TRUE; break;
+            default:
+                fprintf(stderr,"Usage: %s [-v] trace-file\n",argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr,"Usage: %s [-v] trace-file\n",argv[0]);
+        return 1;
+    }
+    struct Trace trace;
+    if (! readTrace(argv[optind],&trace)) return 1;
+
+/* Walk the trace, decoding the bytes sent into commands. A command ends when
+the next one starts, and whatever came back in the meantime is its reply. */
+    struct Command command;
+    int active = FALSE;
+    uint32_t need = 0;              // Bytes still to come of the command
+    uint8_t header[5];              // Size, memory type and sent size
+    uint32_t headerWanted = 0;
+    uint32_t headerHeld = 0;
+    uint32_t baud = DEFAULT_BAUD;
+    uint64_t txFree = 0;            // When the transmit line is next free
+    if (verbose) printf("   Start ms  Cmd  Sent  Back   Round trip ms   Gap ms\n");
+    for (uint64_t n=0; n < trace.count; n++)
+    {
+        struct TraceRecord *record = &trace.records[n];
+        if (record->kind == TRACE_BAUD)
+        {
+            baud = record->value;
+            continue;
+        }
+        if (record->kind == TRACE_RX)
+        {
+            if (! active) continue;
+            if (command.rxBytes++ == 0) command.firstRx = record->time;
+            command.end = record->time;
+            continue;
+        }
+        if (record->kind != TRACE_TX) continue;
+        uint64_t wire = characterTime(baud);
+        txFree = ((record->time > txFree) ? record->time : txFree) + wire;
+        uint8_t datum = record->value;
+        if ((need == 0) && (headerWanted == 0))
+        {
+            if (active) endCommand(&command,record->time);
+            memset(&command,0,sizeof(command));
+            active = TRUE;
+            command.code = datum;
+            command.start = record->time;
+            need = fixedArguments(datum);
+            headerWanted = headerLength(datum);
+            headerHeld = 0;
+        }
+        else if (headerWanted > 0)
+        {
+            header[headerHeld++] = datum;
+            if (headerHeld == headerWanted)
+            {
+                headerWanted = 0;
+                uint32_t size = (header[0] << 8) | header[1];
+                switch (command.code)
+                {
+                    case 'B': need = size; break;
+                    case 'K': case 'W': need = size + 2; break;
+                    case 'Z': need = ((header[3] << 8) | header[4]) + 2; break;
+                    default: need = 0;
+                }
+            }
+        }
+        else need--;
+        command.txBytes++;
+        command.lastTx = record->time;
+        command.txWire = txFree;
+        command.wire = wire;
+        if (command.end < record->time) command.end = record->time;
+    }
+    if (active) endCommand(&command,command.end);
+    report(&trace,argv[optind]);
+    freeTrace(&trace);
+    free(trips);
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Add a finished command to the totals
+
+@param[in] command The command and its reply
+@param[in] next Time the next command started
+*/
+
+static void endCommand(struct Command *command, const uint64_t next)
+{
+    struct CommandStats *entry = &stats[command->code];
+    uint64_t time = command->end - command->start;
+    uint64_t gap = (next > command->end) ? next - command->end : 0;
+    entry->count++;
+    entry->time += time;
+    entry->txBytes += command->txBytes;
+    entry->rxBytes += command->rxBytes;
+    phaseTime[phaseOf(command->code)] += time;
+    phaseCount[phaseOf(command->code)]++;
+    gapTime += gap;
+    int replied = (command->rxBytes > 0) && (command->firstRx >= command->lastTx);
+    uint64_t trip = replied ? command->firstRx - command->lastTx : 0;
+    if (replied)
+    {
+/* The first byte back has spent a character time on the wire itself */
+        uint64_t wireDone = command->txWire + command->wire;
+        uint64_t beyond = 0;
+        if (command->firstRx > wireDone) beyond = command->firstRx - wireDone;
+        entry->replies++;
+        entry->beyondWire += beyond;
+        if ((entry->replies == 1) || (beyond < entry->leastBeyond))
+            entry->leastBeyond = beyond;
+        addTrip(command->code,trip);
+        uint32_t bucket = 0;
+        while ((bucket < BUCKETS-1) && (trip >= (BUCKET_BASE << bucket))) bucket++;
+        histogram[bucket]++;
+    }
+    if (verbose)
+    {
+        printf("%11.3f  %-3s %5u %5u ",command->start/1e6,printable(command->code),
+               command->txBytes,command->rxBytes);
+        if (replied) printf("%15.3f ",trip/1e6);
+        else printf("%15s ","-");
+        printf("%8.3f\n",gap/1e6);
+    }
+}
+
+/*****************************************************************************/
+/** @brief Share of the session the link was carrying data
+
+Each byte received is taken to have been on the wire for a character time
+before it was stamped. Bytes sent are queued behind each other from when they
+were written. Overlapping times are counted once.
+
+@param[in] trace The trace
+@param[out] txBusy Time the PC to programmer line was busy (ns)
+@param[out] rxBusy Time the programmer to PC line was busy (ns)
+@returns the time either line was busy (ns)
+*/
+
+static uint64_t busyTime(const struct Trace *trace, uint64_t *txBusy,
+                         uint64_t *rxBusy)
+{
+    uint32_t baud = DEFAULT_BAUD;
+    uint64_t txFree = 0;
+    uint64_t rxFree = 0;
+    uint64_t either = 0;
+    uint64_t eitherFree = 0;
+    *txBusy = 0;
+    *rxBusy = 0;
+    for (uint64_t n=0; n < trace->count; n++)
+    {
+        struct TraceRecord *record = &trace->records[n];
+        uint64_t wire = characterTime(baud);
+        uint64_t start, end;
+        if (record->kind == TRACE_BAUD)
+        {
+            baud = record->value;
+            continue;
+        }
+        else if (record->kind == TRACE_TX)
+        {
+            start = (record->time > txFree) ? record->time : txFree;
+            end = start + wire;
+            txFree = end;
+            *txBusy += wire;
+        }
+        else if (record->kind == TRACE_RX)
+        {
+            start = (record->time > wire) ? record->time - wire : 0;
+            if (start < rxFree) start = rxFree;
+            end = (record->time > start) ? record->time : start;
+            rxFree = end;
+            *rxBusy += end - start;
+        }
+        else continue;
+/* Sent bytes can be queued well past received ones, so the union is only
+approximate when the two are far out of step. */
+        if (start < eitherFree) start = eitherFree;
+        if (end > start) either += end - start;
+        if (end > eitherFree) eitherFree = end;
+    }
+    return either;
+}
+
+/*****************************************************************************/
+/** @brief Print the report */
+
+static void report(const struct Trace *trace, const char *fileName)
+{
+    if (trace->count == 0)
+    {
+        printf("%s holds no records\n",fileName);
+        return;
+    }
+    uint64_t session = trace->records[trace->count-1].time - trace->records[0].time;
+    if (session == 0) session = 1;
+    uint64_t txBusy, rxBusy;
+    uint64_t either = busyTime(trace,&txBusy,&rxBusy);
+    printf("%s: %llu records",fileName,(unsigned long long)trace->count);
+    if (trace->lost > 0)
+        printf(" (%llu earlier ones lost)",(unsigned long long)trace->lost);
+    printf(", session %.3f s\n\n",session/1e9);
+    printf("Link busy: PC to programmer %.1f%%, programmer to PC %.1f%%, "
+           "either %.1f%%\n\n",100.0*txBusy/session,100.0*rxBusy/session,
+           100.0*either/session);
+
+    printf("Phase       Commands      Time s   Share\n");
+    for (int n=0; n < PHASES; n++)
+    {
+        if (phaseCount[n] == 0) continue;
+        printf("%-10s  %8u  %10.3f  %5.1f%%\n",phaseName[n],phaseCount[n],
+               phaseTime[n]/1e9,100.0*phaseTime[n]/session);
+    }
+    printf("%-10s  %8s  %10.3f  %5.1f%%   (PC between a reply and the next "
+           "command)\n\n","Host gaps","",gapTime/1e9,100.0*gapTime/session);
+
+    qsort(trips,tripCount,sizeof(struct RoundTrip),compareTrips);
+    printf("Cmd   Count   Total ms   Mean ms   Sent   Back   Round trip ms "
+           "(median p90 max)   Beyond wire ms (mean least)\n");
+    uint32_t first = 0;
+    for (int code=0; code < 256; code++)
+    {
+        struct CommandStats *entry = &stats[code];
+        if (entry->count == 0) continue;
+        printf("%-3s %7u %10.3f %9.3f %6llu %6llu ",printable(code),entry->count,
+               entry->time/1e6,entry->time/1e6/entry->count,
+               (unsigned long long)entry->txBytes,(unsigned long long)entry->rxBytes);
+        while ((first < tripCount) && (trips[first].code < code)) first++;
+        uint32_t last = first;
+        while ((last < tripCount) && (trips[last].code == code)) last++;
+        uint32_t samples = last - first;
+        if (samples > 0)
+        {
+            printf("  %9.3f %7.3f %7.3f   %12.3f %7.3f\n",
+                   trips[first + samples/2].time/1e6,
+                   trips[first + (samples*9)/10].time/1e6,
+                   trips[last-1].time/1e6,
+                   entry->beyondWire/1e6/entry->replies,entry->leastBeyond/1e6);
+        }
+        else printf("  %9s %7s %7s   %12s %7s\n","-","-","-","-","-");
+        first = last;
+    }
+
+/* The adaptor's own latency shows in commands the firmware answers at once */
+    const char *quick = "aSVpOt";
+    uint64_t adaptor = 0;
+    int found = FALSE;
+    for (const char *code = quick; *code; code++)
+    {
+        struct CommandStats *entry = &stats[(uint8_t)*code];
+        if (entry->replies == 0) continue;
+        if (! found || (entry->leastBeyond < adaptor)) adaptor = entry->leastBeyond;
+        found = TRUE;
+    }
+    if (found)
+        printf("\nAdaptor latency estimate: %.3f ms (least beyond wire time of "
+               "commands the programmer answers at once)\n",adaptor/1e6);
+
+    printf("\nRound trip (last byte sent to first byte back), %u commands\n",
+           tripCount);
+    uint32_t most = 0;
+    for (int n=0; n < BUCKETS; n++) if (histogram[n] > most) most = histogram[n];
+    for (int n=0; n < BUCKETS; n++)
+    {
+        if (histogram[n] == 0) continue;
+        int bar = (most > 0) ? (histogram[n]*50 + most-1)/most : 0;
+        if (n < BUCKETS-1) printf("  < %9.3f ms ",(BUCKET_BASE << n)/1e6);
+        else printf(" >= %9.3f ms ",(BUCKET_BASE << (n-1))/1e6);
+        printf("%8u %.*s\n",histogram[n],bar,
+               "##################################################");
+    }
+}
+
+/*****************************************************************************/
+/** @brief Phase a command belongs to */
+
+static enum Phase phaseOf(const uint8_t code)
+{
+    if (strchr("aSVpOtbPULsEXxyT",code) && code) return SETUP;
+    if (code == 'A') return ADDRESS;
+    if (code == 'e') return ERASE;
+    if (strchr("BWKZcCmD",code) && code) return WRITE;
+    if (strchr("gGHRd",code) && code) return READ;
+    if (strchr("rlFfNnQq",code) && code) return FUSES;
+    if ((code == ESC) || (code == IDLE_CHAR)) return RESYNC;
+    return OTHER;
+}
+
+/*****************************************************************************/
+/** @brief Bytes that follow a command character, other than a block */
+
+static uint32_t fixedArguments(const uint8_t code)
+{
+    if (code == 'A') return 2;
+    if (code && strchr("xyTcCDlfnq",code)) return 1;
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Bytes giving the size and type of a block command, 0 if not one */
+
+static uint32_t headerLength(const uint8_t code)
+{
+    if (code == 'Z') return 5;
+    if (code && strchr("BWKgGH",code)) return 3;
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Keep a round trip for the percentiles */
+
+static void addTrip(const uint8_t code, const uint64_t time)
+{
+    if (tripCount >= tripSpace)
+    {
+        tripSpace = tripSpace ? tripSpace*2 : 1024;
+        trips = realloc(trips,tripSpace*sizeof(struct RoundTrip));
+        if (trips == 0)
+        {
+            fprintf(stderr,"No memory for round trips\n");
+            exit(1);
+        }
+    }
+    trips[tripCount].code = code;
+    trips[tripCount].time = time;
+    tripCount++;
+}
+
+/*****************************************************************************/
+/** @brief Order round trips by command, then by time */
+
+static int compareTrips(const void *a, const void *b)
+{
+    const struct RoundTrip *x = a;
+    const struct RoundTrip *y = b;
+    if (x->code != y->code) return (x->code < y->code) ? -1 : 1;
+    if (x->time != y->time) return (x->time < y->time) ? -1 : 1;
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Name of a command character */
+
+static const char *printable(const uint8_t code)
+{
+    static char name[4];
+    if (code == ESC) return "ESC";
+    if ((code >= ' ') && (code < 0x7F)) snprintf(name,sizeof(name),"%c",code);
+    else snprintf(name,sizeof(name),"%02X",code);
+    return name;
+}
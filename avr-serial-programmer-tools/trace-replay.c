@@ -0,0 +1,369 @@
+/**
+@file trace-replay.c
+@brief Play back the programmer's side of a recorded session
+
+@details A trace recorded by the PC program (-T) on a particular board and
+adaptor holds everything the programmer sent back, and when. This opens a
+pseudo-terminal and plays the programmer's part to the current PC program. The
+PC program's bytes are checked against those it sent in the recording, and each
+reply goes back after the same delay from the byte before it as in the
+recording. A change in the PC program can then be run against a session from
+the field without the hardware it came from.
+
+The replay stops at the first byte that differs from the recording, and says
+where that was. At the end, the PC program's own time (from a reply arriving to
+its next byte going out) is compared with the recording in total, and the
+places where it has grown the most are listed. The programmer's time is the
+same by construction, so any change in the session time is the PC program's.
+
+    trace-replay [-t scale] [-w s] [-L link] [-v] trace-file
+    avrserialprog -P /dev/pts/N ...
+
+- -t scale  stretch the reply delays by scale, default 1
+- -w s      give up when the PC program sends nothing for s seconds, default 10
+- -L path   also make a symbolic link to the pty at path
+- -v        list each exchange with its recorded and replayed times
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include "tracefile.h"
+
+#define CONTEXT     16              // Bytes shown either side of a difference
+#define WORST       5               // Host times listed that grew the most
+
+/** @brief PC program's time before one of its bytes that followed a reply */
+struct HostTime
+{
+    uint64_t record;                // Index of the byte in the trace
+    uint64_t recorded;              // Time from the reply (ns)
+    uint64_t replayed;
+};
+
+static int master = -1;
+static const char *linkPath;
+static double scale = 1.0;
+static int waitLimit = 10;
+static int verbose;
+static uint64_t realStart;
+static struct HostTime *hostTimes;
+static uint64_t hostCount;
+
+static uint64_t realTime(void);
+static void openPty(void);
+static int receive(uint8_t *datum);
+static void sendAt(const uint8_t datum, const uint64_t due);
+static void showDifference(const struct Trace *trace, const uint64_t index,
+                           const uint8_t datum);
+static void report(const struct Trace *trace, const uint64_t reached,
+                   const uint64_t recordedEnd, const uint64_t replayedEnd);
+static int compareGrowth(const void *a, const void *b);
+
+/*****************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc,argv,"t:w:L:v")) != -1)
+    {
+        switch (c)
+        {
+            case 't': scale = strtod(optarg,0); break;
+            case 'w': waitLimit = atoi(optarg); break;
+            case 'L': linkPath = optarg; break;
+            case 'v': verbose = TRUE; break;
+            default:
+                fprintf(stderr,"Usage: %s [-t scale] [-w s] [-L link] [-v] "
+                        "trace-file\n",argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr,"Usage: %s [-t scale] [-w s] [-L link] [-v] trace-file\n",
+                argv[0]);
+        return 1;
+    }
+    struct Trace trace;
+    if (! readTrace(argv[optind],&trace)) return 1;
+    if (trace.lost > 0)
+        fprintf(stderr,"The start of the session was lost from the trace, "
+                       "the replay will not match it\n");
+    hostTimes = malloc((trace.count > 0 ? trace.count : 1)*sizeof(struct HostTime));
+    if (hostTimes == 0)
+    {
+        fprintf(stderr,"No memory for the replay\n");
+        return 1;
+    }
+    openPty();
+
+/* Each byte the PC sent is waited for. Each reply byte is sent at its recorded
+delay from the PC's byte before it, or from the start if there was none. */
+    uint64_t recordedAnchor = 0;    // Last PC byte, recorded and replayed
+    uint64_t replayedAnchor = 0;
+    uint64_t recordedReply = 0;     // Last reply byte, recorded and replayed
+    uint64_t replayedReply = 0;
+    int replied = FALSE;            // A reply came after the last PC byte
+    uint64_t n;
+    int matched = TRUE;
+    if (trace.count > 0) recordedAnchor = trace.records[0].time;
+    realStart = realTime();
+    for (n=0; (n < trace.count) && matched; n++)
+    {
+        struct TraceRecord *record = &trace.records[n];
+        if (record->kind == TRACE_RX)
+        {
+            uint64_t due = replayedAnchor +
+                           (record->time - recordedAnchor)*scale;
+            sendAt(record->value,due);
+            recordedReply = record->time;
+            replayedReply = realTime() - realStart;
+            replied = TRUE;
+        }
+        else if (record->kind == TRACE_TX)
+        {
+            uint8_t datum;
+            if (! receive(&datum))
+            {
+                printf("The PC program stopped after %llu of %llu records, "
+                       "%.3f s into the recording\n",(unsigned long long)n,
+                       (unsigned long long)trace.count,
+                       (record->time - trace.records[0].time)/1e9);
+                break;
+            }
+            uint64_t now = realTime() - realStart;
+            if (datum != (uint8_t)record->value)
+            {
+                showDifference(&trace,n,datum);
+                matched = FALSE;
+                break;
+            }
+            if (replied)
+            {
+                struct HostTime *entry = &hostTimes[hostCount++];
+                entry->record = n;
+                entry->recorded = record->time - recordedReply;
+                entry->replayed = (now > replayedReply) ? now - replayedReply : 0;
+                if (verbose)
+                    printf("%10.3f ms  reply to byte %02X: recorded %9.3f ms, "
+                           "replayed %9.3f ms\n",(record->time -
+                           trace.records[0].time)/1e6,datum,entry->recorded/1e6,
+                           entry->replayed/1e6);
+            }
+            replied = FALSE;
+            recordedAnchor = record->time;
+            replayedAnchor = now;
+        }
+    }
+    uint64_t recordedEnd = (n > 0) ? trace.records[n-1].time - trace.records[0].time : 0;
+    report(&trace,n,recordedEnd,realTime() - realStart);
+    if (linkPath != 0) unlink(linkPath);
+    free(hostTimes);
+    freeTrace(&trace);
+    return ((n >= trace.count) && matched) ? 0 : 2;
+}
+
+/*****************************************************************************/
+/** @brief Open the pseudo-terminal and announce it
+
+As in the emulator, the slave is held open and set raw so that the PC program
+can open and close it as it likes.
+*/
+
+static void openPty(void)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0))
+    {
+        perror("Cannot open a pty");
+        exit(1);
+    }
+    const char *name = ptsname(master);
+    int slave = open(name,O_RDWR | O_NOCTTY);
+    struct termios settings;
+    if ((slave < 0) || (tcgetattr(slave,&settings) < 0))
+    {
+        perror("Cannot open the pty slave");
+        exit(1);
+    }
+    cfmakeraw(&settings);
+    tcsetattr(slave,TCSANOW,&settings);
+    if (linkPath != 0)
+    {
+        unlink(linkPath);
+        if (symlink(name,linkPath) < 0) perror("Cannot link to the pty");
+    }
+    printf("%s\n",name);
+    fflush(stdout);
+}
+
+/*****************************************************************************/
+/** @brief Wait for a byte from the PC program
+
+@param[out] datum The byte
+@returns FALSE if nothing came within the wait limit
+*/
+
+static int receive(uint8_t *datum)
+{
+    uint64_t start = realTime();
+    while (realTime() - start < waitLimit*1000000000ULL)
+    {
+        struct pollfd in = { master, POLLIN, 0 };
+        if (poll(&in,1,100) <= 0) continue;
+        ssize_t n = read(master,datum,1);
+        if (n == 1) return TRUE;
+/* EIO means the slave is not open, but we hold it, so this doesn't last */
+        if ((n < 0) && (errno != EAGAIN) && (errno != EINTR) && (errno != EIO))
+        {
+            perror("pty read");
+            exit(1);
+        }
+        usleep(1000);
+    }
+    return FALSE;
+}
+
+/*****************************************************************************/
+/** @brief Send a byte to the PC program once its time has come
+
+@param[in] datum The byte
+@param[in] due Time since the start of the replay (ns)
+*/
+
+static void sendAt(const uint8_t datum, const uint64_t due)
+{
+    uint64_t now = realTime() - realStart;
+    if (due > now)
+    {
+        struct timespec pause = { (due-now)/1000000000ULL, (due-now)%1000000000ULL };
+        nanosleep(&pause,0);
+    }
+    while (write(master,&datum,1) != 1)
+    {
+        if ((errno != EAGAIN) && (errno != EINTR))
+        {
+            perror("pty write");
+            exit(1);
+        }
+        usleep(1000);
+    }
+}
+
+/*****************************************************************************/
+/** @brief Show where the PC program left the recording
+
+The bytes sent by the PC either side of the difference are shown, as recorded.
+
+@param[in] trace The recording
+@param[in] index Record the PC program should have matched
+@param[in] datum What it sent instead
+*/
+
+static void showDifference(const struct Trace *trace, const uint64_t index,
+                           const uint8_t datum)
+{
+    uint64_t offset = 0;
+    for (uint64_t n=0; n < index; n++)
+        if (trace->records[n].kind == TRACE_TX) offset++;
+    printf("The PC program differs from the recording at byte %llu it sent, "
+           "%.3f s in: %02X where %02X was recorded\n",(unsigned long long)offset,
+           (trace->records[index].time - trace->records[0].time)/1e9,datum,
+           trace->records[index].value);
+    printf("Recorded around it (> sent, < received, [] the difference):\n ");
+    uint64_t first = (index > CONTEXT) ? index - CONTEXT : 0;
+    for (uint64_t n=first; (n < trace->count) && (n <= index + CONTEXT); n++)
+    {
+        const struct TraceRecord *record = &trace->records[n];
+        if (record->kind == TRACE_BAUD) continue;
+        printf((n == index) ? " [%c%02X]" : " %c%02X",
+               (record->kind == TRACE_TX) ? '>' : '<',record->value);
+    }
+    printf("\n");
+}
+
+/*****************************************************************************/
+/** @brief Compare the replay's timing with the recording */
+
+static void report(const struct Trace *trace, const uint64_t reached,
+                   const uint64_t recordedEnd, const uint64_t replayedEnd)
+{
+    uint64_t recorded = 0;
+    uint64_t replayed = 0;
+    for (uint64_t n=0; n < hostCount; n++)
+    {
+        recorded += hostTimes[n].recorded;
+        replayed += hostTimes[n].replayed;
+    }
+    printf("Replayed %llu of %llu records\n",(unsigned long long)reached,
+           (unsigned long long)trace->count);
+    printf("Session:  recorded %10.3f s, replayed %10.3f s\n",
+           recordedEnd/1e9,replayedEnd/1e9);
+    printf("PC time:  recorded %10.3f s, replayed %10.3f s, %+.3f s over %llu "
+           "replies\n",recorded/1e9,replayed/1e9,
+           ((double)replayed - (double)recorded)/1e9,(unsigned long long)hostCount);
+    if (hostCount == 0) return;
+    qsort(hostTimes,hostCount,sizeof(struct HostTime),compareGrowth);
+    printf("Largest growth in PC time after a reply:\n");
+    for (uint64_t n=0; (n < hostCount) && (n < WORST); n++)
+    {
+        struct HostTime *entry = &hostTimes[n];
+        if (entry->replayed <= entry->recorded) break;
+        printf("  %10.3f s in, before byte %02X: %9.3f ms recorded, "
+               "%9.3f ms replayed\n",(trace->records[entry->record].time -
+               trace->records[0].time)/1e9,trace->records[entry->record].value,
+               entry->recorded/1e6,entry->replayed/1e6);
+    }
+}
+
+/*****************************************************************************/
+/** @brief Order host times by how much they grew, most first */
+
+static int compareGrowth(const void *a, const void *b)
+{
+    const struct HostTime *x = a;
+    const struct HostTime *y = b;
+    double growthX = (double)x->replayed - (double)x->recorded;
+    double growthY = (double)y->replayed - (double)y->recorded;
+    if (growthX != growthY) return (growthX > growthY) ? -1 : 1;
+    return 0;
+}
+
+/*****************************************************************************/
+/** @brief Real time in ns */
+
+static uint64_t realTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint64_t)now.tv_sec*1000000000ULL + now.tv_nsec;
+}
@@ -0,0 +1,123 @@
+/**
+@file tracefile.c
+@brief Reading serial link traces
+
+@details Traces are written by the PC program's SerialTrace class when it is
+given -T. All fields are little endian, and are put together byte by byte so
+that the host byte order doesn't matter.
+*/
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tracefile.h"
+
+#define HEADER_SIZE 32
+#define RECORD_SIZE 16
+
+static uint64_t little(const uint8_t *bytes, const int length);
+
+/*****************************************************************************/
+/** @brief Read a trace file
+
+@param[in] fileName Trace file
+@param[out] trace The records, to be released with freeTrace
+@returns FALSE if the file can't be read or isn't a trace. A message is given
+on stderr.
+*/
+
+int readTrace(const char *fileName, struct Trace *trace)
+{
+    memset(trace,0,sizeof(*trace));
+    FILE *file = fopen(fileName,"rb");
+    if (file == 0)
+    {
+        perror(fileName);
+        return FALSE;
+    }
+    uint8_t header[HEADER_SIZE];
+    if ((fread(header,HEADER_SIZE,1,file) != 1) ||
+        (memcmp(header,TRACE_MAGIC,8) != 0))
+    {
+        fprintf(stderr,"%s is not a serial trace\n",fileName);
+        fclose(file);
+        return FALSE;
+    }
+    if (little(header+8,4) != TRACE_VERSION)
+    {
+        fprintf(stderr,"%s is trace version %u, only %u is known\n",fileName,
+                (unsigned)little(header+8,4),TRACE_VERSION);
+        fclose(file);
+        return FALSE;
+    }
+    uint64_t count = little(header+16,8);
+    trace->lost = little(header+24,8);
+    trace->records = malloc((count > 0 ? count : 1)*sizeof(struct TraceRecord));
+    if (trace->records == 0)
+    {
+        fprintf(stderr,"No memory for %llu records\n",(unsigned long long)count);
+        fclose(file);
+        return FALSE;
+    }
+    uint8_t record[RECORD_SIZE];
+    while ((trace->count < count) && (fread(record,RECORD_SIZE,1,file) == 1))
+    {
+        struct TraceRecord *entry = &trace->records[trace->count++];
+        entry->time = little(record,8);
+        entry->value = little(record+8,4);
+        entry->kind = record[12];
+    }
+    fclose(file);
+    if (trace->count < count)
+        fprintf(stderr,"%s is short, %llu of %llu records read\n",fileName,
+                (unsigned long long)trace->count,(unsigned long long)count);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/** @brief Release the records of a trace */
+
+void freeTrace(struct Trace *trace)
+{
+    free(trace->records);
+    trace->records = 0;
+    trace->count = 0;
+}
+
+/*****************************************************************************/
+/** @brief Time of one character (start, eight data and stop bits) in ns */
+
+uint64_t characterTime(const uint32_t baud)
+{
+    return (10ULL*1000000000ULL)/(baud ? baud : DEFAULT_BAUD);
+}
+
+/*****************************************************************************/
+/** @brief Put together a little endian number */
+
+static uint64_t little(const uint8_t *bytes, const int length)
+{
+    uint64_t value = 0;
+    for (int n=length-1; n >= 0; n--) value = (value << 8) | bytes[n];
+    return value;
+}
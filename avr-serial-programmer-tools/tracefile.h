@@ -0,0 +1,73 @@
+/*          Serial Programmer Tools
+      Ken Sarkies ksarkies@internode.on.net
+            (www.jiggerjuice.net)
+
+File              : tracefile.h
+Compiler          : gcc (C99 with POSIX)
+Target platform   : Linux
+
+Serial link traces recorded by the PC program with -T. The layout is set by
+serialtrace.h in the PC program.
+*/
+
+/****************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies ksarkies@internode.on.net            *
+ *                                                                          *
+ *   This file is part of serial-programmer                                 *
+ *                                                                          *
+ *   serial-programmer is free software; you can redistribute it and/or     *
+ *   modify it under the terms of the GNU General Public License as         *
+ *   published by the Free Software Foundation; either version 2 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   serial-programmer is distributed in the hope that it will be useful,   *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public License      *
+ *   along with serial-programmer. If not, write to the Free Software       *
+ *   Foundation, Inc.,                                                      *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.              *
+ ***************************************************************************/
+
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <inttypes.h>
+
+#define TRUE 1
+#define FALSE 0
+
+#define TRACE_MAGIC     "AVRTRACE"
+#define TRACE_VERSION   1
+
+/* Kinds of trace record */
+#define TRACE_TX        0           // Byte sent to the programmer
+#define TRACE_RX        1           // Byte received from the programmer
+#define TRACE_BAUD      2           // Baud rate changed, value is the rate
+
+/* Baud rate assumed until the trace gives one */
+#define DEFAULT_BAUD    38400
+
+/** @brief One event on the serial link */
+struct TraceRecord
+{
+    uint64_t time;                  // Time since the start of the trace (ns)
+    uint32_t value;                 // Byte, or baud rate
+    uint8_t kind;                   // TRACE_TX, TRACE_RX or TRACE_BAUD
+};
+
+/** @brief A whole trace */
+struct Trace
+{
+    struct TraceRecord *records;
+    uint64_t count;
+    uint64_t lost;                  // Records overwritten before it was saved
+};
+
+int readTrace(const char *fileName, struct Trace *trace);
+void freeTrace(struct Trace *trace);
+uint64_t characterTime(const uint32_t baud);
+
+#endif